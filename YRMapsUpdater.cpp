@@ -4,33 +4,46 @@
  * @author Chrono Vortex#9916@Discord
  */
 
-#pragma comment(lib, "Ws2_32.lib")
-
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
-#include <winsock.h>
-#include <windows.h>
-#include <regex>
 #include <vector>
-#include <map>
-#include "eqor.h"
-#include "initfuncwrap.h"
-
-#define NULLSTR ""
-#define BUFFSIZE 1024
+#include "inidiff.h"
+#include "inidocument.h"
+#include "inventory.h"
+#include "iniwriter.h"
+#include "mapcache.h"
+#include "mpmaps.h"
+#include "platform.h"
+#include "runstats.h"
+#include "sha1.h"
+#include "snapshot.h"
+#include "strutil.h"
+#include "threadpool.h"
+#include "versionconfig.h"
+#include "watcher.h"
 
 namespace fs = std::filesystem;
 
-/**
- * Wrapper for the windows function to get location of this program.
- *
- * @return path to the directory containing this program.
- */
-fs::path program_path() {
-	wchar_t result[MAX_PATH];
-	return fs::path(std::wstring(result, GetModuleFileNameW(NULL, result, MAX_PATH))).remove_filename();
-}
+// exit codes, so scripts can tell why a run stopped
+enum ExitCode {
+	EXIT_OK = 0,
+	EXIT_ERROR = 1,         // something couldn't be read or written
+	EXIT_USAGE = 2,         // bad arguments, or a path batch mode needs wasn't given or doesn't exist
+	EXIT_EXISTS = 3,        // an output file exists and isn't to be replaced
+	EXIT_MISSING_NAMES = 4, // maps without valid names, and not to continue without them
+};
+
+// what to do when a file about to be written already exists
+enum class Overwrite { ask, replace, keep };
+
+// what to do when maps don't have valid names
+enum class MissingNames { ask, skip, stop };
+
+// what to do with the differences between the old MPMaps.ini and the one just built
+enum class DiffOld { none, list, patch };
 
 /**
  * Get yes/no input from the user.
@@ -43,73 +56,6 @@ bool get_yes_no() {
 	return std::tolower(s[0]) == 'y';
 }
 
-/**
- * Check if a string begins with a substring.
- *
- * @param s string to check.
- * @param start substring to check beginning for.
- * @return true if 's' begins with 'start', false if not.
- */
-bool str_startswith(const std::string& s, const std::string& start) {
-	return (s.length() >= start.length()) ? (s.compare(0, start.length(), start) == 0) : false;
-}
-
-/**
- * Check if a string ends with a substring.
- *
- * @param s string to check.
- * @param end substring to check ending for.
- * @return true if 's' ends with 'end', false if not.
- */
-bool str_endswith(const std::string& s, const std::string& end) {
-	return (s.length() >= end.length()) ?
-		(s.compare(s.length() - end.length(), end.length(), end) == 0) : false;
-}
-
-/**
- * Remove specified number of characters from
- * the beginning and end of a string.
- *
- * @param s string to modify.
- * @param left number of characters to remove from the beginning of 's'.
- * @param right number of characters to remove from the end of 's'.
- * @return modified copy of 's'.
- */
-std::string str_cutends(const std::string& s, const int& left, const int& right) {
-	int len = s.size() - left - right;
-	if (len <= 0)
-		return NULLSTR;
-	return s.substr(left, len);
-}
-
-/**
- * Capitalizes the first letter of each word in a string,
- * e.g. "hello, world!" becomes "Hello, World!".
- *
- * @param s string to capitalize.
- * @return capitalized copy of 's'.
- */
-std::string str_titlecase(std::string s) {
-	bool capNextLetter = true;
-	for (std::string::size_type i = 0; i < s.size(); ++i) {
-		if (capNextLetter) {
-			if (std::isalpha(s[i])) {
-				s[i] = std::toupper(s[i]);
-				capNextLetter = false;
-			}
-		}
-		else {
-			if (std::isalpha(s[i])) {
-				s[i] = std::tolower(s[i]);
-			}
-			else {
-				capNextLetter = true;
-			}
-		}
-	}
-	return s;
-}
-
 /**
  * https://stackoverflow.com/questions/14539867/how-to-display-a-progress-indicator-in-pure-c-c-cout-printf#answer-14539953
  * Creates a progress bar string.
@@ -131,42 +77,22 @@ std::string progress_to_string(const float& completed, const float& toComplete,
 	return progressStr + "] " + std::to_string(int(progress * 100.0)) + '%';
 }
 
-/**
- * https://stackoverflow.com/questions/5354459/c-how-to-get-the-image-size-of-a-png-file-in-directory#answer-5354657
- * Gets the dimensions of a PNG image
- * in a path as a pair of integers.
- *
- * @param pngPath path to the PNG image to get the dimensions of.
- * @return pair of integers containing the dimensions.
- */
-std::pair<int, int> png_getsize(const fs::path& pngPath) {
-	if (!fs::exists(pngPath))
-		throw std::invalid_argument("no file at specified path");
-
-	std::ifstream in(pngPath);
-	int magic;
-	in.read((char*)&magic, 4);
-	if (ntohl(magic) != 0x89504E47)
-		throw std::invalid_argument("specified file is not a png");
-
-	int width, height;
-	in.seekg(16);
-	in.read((char*)&width, 4);
-	in.read((char*)&height, 4);
-	return std::pair<int, int>(ntohl(width), ntohl(height));
-}
-
 /**
  * Check if the file exists before settiling on a path,
  * give user the option to rename if it does.
  *
  * @param dir directory for the file.
  * @param fname name of the file.
- * @return path to the file.
+ * @param overwrite what to do if the file exists, only 'ask' prompts the user.
+ * @return path to the file, empty if it exists and is to be kept.
  */
-fs::path path_check_exists(const fs::path& dir, const std::string& fname) {
+fs::path path_check_exists(const fs::path& dir, const std::string& fname, Overwrite overwrite = Overwrite::ask) {
 	auto path = dir / fname;
-	if (fs::exists(path)) {
+	if (fs::exists(path) && overwrite == Overwrite::keep) {
+		std::cout << path.string() << " already exists" << std::endl;
+		return fs::path();
+	}
+	if (fs::exists(path) && overwrite == Overwrite::ask) {
 		std::cout << path.string() << " already exists, would you like to replace it? [y/N] ";
 		if (!get_yes_no()) {
 			std::cout << "Please enter an alternate filename: " << std::endl;
@@ -179,50 +105,493 @@ fs::path path_check_exists(const fs::path& dir, const std::string& fname) {
 }
 
 const fs::path pathsIniPath = program_path() / "PathsYRMU.ini";
-const fs::path mapsPathRelative("Maps\\Yuri's Revenge");
+const fs::path mapCachePath = program_path() / "MapCacheYRMU.bin";
+const fs::path mapsPathRelative = fs::path("Maps") / "Yuri's Revenge";
 
-int main(int argc, const char** argv) {
-	// we'll use this buffer to get the string from GetPrivateProfileString every time we use it
-	char buffer[BUFFSIZE];
+/**
+ * Get a path saved in PathsYRMU.ini.
+ *
+ * @param key name of the path.
+ * @return saved path, empty if there isn't one.
+ */
+std::string paths_ini_get(const std::string& key) {
+	return std::string(IniDocument(pathsIniPath).get("PATHS", key));
+}
+
+/**
+ * Save a path to PathsYRMU.ini, keeping everything else in it as it is.
+ *
+ * @param key name of the path.
+ * @param value path to save.
+ */
+void paths_ini_set(const std::string& key, const std::string& value) {
+	IniWriter paths;
+	paths.load(pathsIniPath);
+	paths.set("PATHS", key, value);
+	if (!paths.save(pathsIniPath))
+		std::cout << "Unable to write " << pathsIniPath.string() << std::endl;
+}
+
+/**
+ * Compare a newly built MPMaps.ini with the old one, write the sections and keys which
+ * changed to mpmaps_changes.txt next to it, and patch them into the old one if asked to.
+ * The old file is only written if something changed, every line which didn't stays as it is.
+ *
+ * @param mpmaps MPMaps.ini as it was built.
+ * @param mpmapsOld the old MPMaps.ini.
+ * @param mpmapsOldPath path to the old MPMaps.ini.
+ * @param outputDir directory to write the changes to.
+ * @param diffOld list the changes, or list them and patch the old MPMaps.ini.
+ * @param overwrite what to do if the list of changes already exists.
+ * @return exit code.
+ */
+int diff_old_mpmaps(const IniWriter& mpmaps, const IniDocument& mpmapsOld, const fs::path& mpmapsOldPath,
+		const fs::path& outputDir, DiffOld diffOld, Overwrite overwrite) {
+	std::string built = mpmaps.str();
+	const IniDocument mpmapsNew(std::vector<char>(built.begin(), built.end()));
+	IniDiff diff = diff_ini(mpmapsOld, mpmapsNew);
+	fs::path outPath = path_check_exists(outputDir, "mpmaps_changes.txt", overwrite);
+	if (outPath.empty())
+		return EXIT_EXISTS;
+	std::ofstream changes(outPath);
+	write_ini_diff(changes, diff);
+	changes.close();
+	std::cout << diff.added.size() << " sections added, " << diff.removed.size() << " removed and " << diff.changed.size()
+		<< " changed since the old MPMaps.ini, wrote them to " << outPath.string() << std::endl;
+	if (diffOld != DiffOld::patch)
+		return EXIT_OK;
+	if (diff.empty()) {
+		std::cout << mpmapsOldPath.string() << " is up to date, left as it is" << std::endl;
+		return EXIT_OK;
+	}
+	IniWriter patched;
+	patched.load(mpmapsOldPath);
+	patch_ini(patched, diff);
+	if (!patched.save_replace(mpmapsOldPath)) {
+		std::cout << "Unable to write " << mpmapsOldPath.string() << std::endl;
+		return EXIT_ERROR;
+	}
+	std::cout << "Patched the changes into " << mpmapsOldPath.string() << std::endl;
+	return EXIT_OK;
+}
+
+/**
+ * Rebuild MPMaps.ini whenever a map, MPMapsBase.ini or the old MPMaps.ini changes, until the program is closed.
+ * Every map stays in memory between rebuilds, so only the maps which changed are read again.
+ *
+ * @param pool threads to read maps on.
+ * @param cncnetPath path to CnCNet.
+ * @param mapsPathFull path to the maps.
+ * @param mpmapsOldPath path to the old MPMaps.ini.
+ * @param mpmapsBasePath path to MPMapsBase.ini.
+ * @param mpmapsPath path to write MPMaps.ini to.
+ * @param embedded what to do for maps without a PNG preview.
+ * @param maps every map as of the last build.
+ */
+[[noreturn]] void watch_maps(ThreadPool& pool, const fs::path& cncnetPath, const fs::path& mapsPathFull, const fs::path& mpmapsOldPath,
+		const fs::path& mpmapsBasePath, const fs::path& mpmapsPath, EmbeddedPreviews embedded, MapSet maps) {
+	TreeWatcher watcher;
+	watcher.watch_tree(mapsPathFull);
+	watcher.watch_file(mpmapsOldPath);
+	watcher.watch_file(mpmapsBasePath);
+	std::cout << "Watching " << mapsPathFull.string() << " for changes" << (watcher.polling() ? " by polling" : "")
+		<< ", close the window or press Ctrl+C to stop" << std::endl;
+
+	MapCache cache;
+	cache_maps(cache, maps);
+	FileStamp mpmapsOldStamp = file_stamp(mpmapsOldPath);
+	IniDocument mpmapsOld(mpmapsOldPath);
+	for (;;) {
+		watcher.wait();
+		auto start = std::chrono::steady_clock::now();
+		FileInventory inventory;
+		try {
+			inventory.scan(cncnetPath, mapsPathFull);
+		}
+		catch (const fs::filesystem_error& e) { // something was moved while we walked the tree, the next change will retry
+			std::cout << "Unable to scan maps: " << e.what() << std::endl;
+			continue;
+		}
+		if (file_stamp(mpmapsOldPath) != mpmapsOldStamp) {
+			mpmapsOldStamp = file_stamp(mpmapsOldPath);
+			mpmapsOld = IniDocument(mpmapsOldPath);
+		}
+
+		SharedMaps shared;
+		maps = read_maps(pool, inventory, cncnetPath, cache, shared);
+		read_previews(pool, maps, cncnetPath);
+		cache_maps(cache, maps);
+		if (!cache.save_replace(mapCachePath))
+			std::cout << "Unable to write " << mapCachePath.string() << std::endl;
+		read_embedded_previews(pool, maps, cncnetPath, embedded);
+
+		MapNames names = name_maps(pool, maps, mpmapsOld);
+		IniWriter mpmaps;
+		mpmaps.load(mpmapsBasePath);
+		build_mpmaps(mpmaps, pool, maps, names, mpmapsOld);
+		if (!mpmaps.save_replace(mpmapsPath)) {
+			std::cout << "Unable to write " << mpmapsPath.string() << std::endl;
+			continue;
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Rebuilt MPMaps.ini in " << size_t(ms) << " ms, read " << maps.keys.size() - maps.reused << " of "
+			<< maps.keys.size() << " maps";
+		if (!names.missing.empty())
+			std::cout << ", " << names.missing.size() << " maps without valid names were left out";
+		std::cout << std::endl;
+	}
+}
+
+/**
+ * Turn a path from an INI file into a path for this platform, they're written with backslashes.
+ *
+ * @param s path as written in the file.
+ * @param base directory a relative path is relative to.
+ * @return the path.
+ */
+fs::path ini_path(std::string s, const fs::path& base) {
+	if (fs::path::preferred_separator == '/')
+		std::replace(s.begin(), s.end(), '\\', '/');
+	fs::path path(s);
+	return path.is_absolute() ? path : base / path;
+}
 
-	// create PathsYRMU.ini to save required paths if it doesn't already exists
-	if (!fs::exists(pathsIniPath))
+/**
+ * Build MPMaps.ini for several map trees in one go, without any prompts. Each
+ * section of the trees file is one tree:
+ *
+ *   [Name]
+ *   Root=path to the client, what section names are relative to
+ *   Maps=maps directory, relative to Root (default Maps\Yuri's Revenge)
+ *   OldMPMaps=old MPMaps.ini, relative to Root (default INI\MPMaps.ini)
+ *   Base=MPMapsBase.ini (default the one next to the executable)
+ *   Output=where to write MPMaps.ini
+ *
+ * Root, Base and Output are relative to the trees file. Every tree shares the
+ * pool and the maps read, so a map copied into several trees is parsed once.
+ *
+ * @param pool threads to read maps on.
+ * @param treesPath path to the trees file.
+ * @param overwrite what to do when an output file exists.
+ * @param missingNames what to do when a tree has maps without valid names.
+ * @param embedded what to do for maps without a PNG preview.
+ * @param diffOld what to do with the differences between each tree's old MPMaps.ini and the new one.
+ * @return exit code, the first tree to fail decides it.
+ */
+int run_trees(ThreadPool& pool, const fs::path& treesPath, Overwrite overwrite, MissingNames missingNames, EmbeddedPreviews embedded,
+		DiffOld diffOld) {
+	struct Tree {
+		std::string name;
+		fs::path root, mapsDir, mpmapsOldPath, basePath, outputPath;
+		FileInventory inventory;
+		bool scanned = false;
+	};
+	const IniDocument treesIni(treesPath);
+	const fs::path treesDir = fs::absolute(treesPath).parent_path();
+	std::vector<Tree> trees(treesIni.all_sections().size());
+	for (size_t t = 0; t < trees.size(); ++t) {
+		const IniDocument::Section& section = treesIni.all_sections()[t];
+		Tree& tree = trees[t];
+		tree.name = section.name;
+		std::string root(treesIni.get(section.name, "Root"));
+		std::string output(treesIni.get(section.name, "Output"));
+		if (root.empty() || output.empty()) {
+			std::cout << "[" << tree.name << "] in " << treesPath.string() << " needs both Root and Output" << std::endl;
+			return EXIT_USAGE;
+		}
+		tree.root = ini_path(root, treesDir);
+		tree.mapsDir = ini_path(std::string(treesIni.get(section.name, "Maps", "Maps\\Yuri's Revenge")), tree.root);
+		tree.mpmapsOldPath = ini_path(std::string(treesIni.get(section.name, "OldMPMaps", "INI\\MPMaps.ini")), tree.root);
+		std::string base(treesIni.get(section.name, "Base"));
+		tree.basePath = base.empty() ? program_path() / "MPMapsBase.ini" : ini_path(base, treesDir);
+		tree.outputPath = ini_path(output, treesDir);
+		if (!fs::exists(tree.mapsDir) || !fs::exists(tree.basePath)) {
+			std::cout << "[" << tree.name << "] unable to find " << (fs::exists(tree.mapsDir) ? tree.basePath : tree.mapsDir).string() << std::endl;
+			return EXIT_USAGE;
+		}
+		if (!fs::is_directory(tree.outputPath.parent_path())) {
+			std::cout << "[" << tree.name << "] directory " << tree.outputPath.parent_path().string() << " for Output doesn't exist" << std::endl;
+			return EXIT_USAGE;
+		}
+		if (fs::exists(tree.outputPath) && overwrite != Overwrite::replace) {
+			std::cout << tree.outputPath.string() << " already exists" << std::endl;
+			return EXIT_EXISTS;
+		}
+	}
+	if (trees.empty()) {
+		std::cout << "No trees in " << treesPath.string() << std::endl;
+		return EXIT_USAGE;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	pool.parallel_for(trees.size(), [&](size_t t, size_t) {
+		try {
+			trees[t].inventory.scan(trees[t].root, trees[t].mapsDir);
+			trees[t].scanned = true;
+		}
+		catch (const fs::filesystem_error&) {}
+	});
+	std::vector<MapTree> mapTrees;
+	for (const Tree& tree : trees) {
+		if (!tree.scanned) {
+			std::cout << "[" << tree.name << "] unable to scan " << tree.mapsDir.string() << std::endl;
+			return EXIT_ERROR;
+		}
+		mapTrees.push_back(MapTree{ tree.root, &tree.inventory });
+	}
+	SharedMaps shared;
+	std::vector<MapSet> sets = read_map_trees(pool, mapTrees, shared);
+
+	int result = EXIT_OK;
+	for (size_t t = 0; t < trees.size(); ++t) {
+		const Tree& tree = trees[t];
+		MapSet& maps = sets[t];
+		read_previews(pool, maps, tree.root);
+		read_embedded_previews(pool, maps, tree.root, embedded);
+		const IniDocument mpmapsOld(tree.mpmapsOldPath);
+		MapNames names = name_maps(pool, maps, mpmapsOld);
+		if (!names.missing.empty()) {
+			fs::path outPath = path_check_exists(tree.outputPath.parent_path(), "map_names_missing.txt", overwrite);
+			if (outPath.empty()) {
+				result = (result == EXIT_OK) ? EXIT_EXISTS : result;
+				continue;
+			}
+			std::ofstream missingMaps(outPath);
+			for (const std::string& s : names.missing)
+				missingMaps << s << std::endl;
+			std::cout << "[" << tree.name << "] unable to find valid names for " << names.missing.size()
+				<< " maps, wrote them to " << outPath.string() << std::endl;
+			if (missingNames != MissingNames::skip) {
+				result = (result == EXIT_OK) ? EXIT_MISSING_NAMES : result;
+				continue;
+			}
+		}
+		IniWriter mpmaps;
+		mpmaps.load(tree.basePath);
+		build_mpmaps(mpmaps, pool, maps, names, mpmapsOld);
+		if (!mpmaps.save_replace(tree.outputPath)) {
+			std::cout << "Unable to write " << tree.outputPath.string() << std::endl;
+			result = (result == EXIT_OK) ? EXIT_ERROR : result;
+			continue;
+		}
+		std::cout << "[" << tree.name << "] built " << tree.outputPath.string() << " from " << maps.keys.size() << " maps, "
+			<< maps.shared << " of them copies of maps already read" << std::endl;
+		if (diffOld != DiffOld::none) {
+			int diffResult = diff_old_mpmaps(mpmaps, mpmapsOld, tree.mpmapsOldPath, tree.outputPath.parent_path(), diffOld, overwrite);
+			result = (result == EXIT_OK) ? diffResult : result;
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Built " << trees.size() << " trees in " << size_t(ms) << " ms" << std::endl;
+	return result;
+}
+
+int main(int argc, const char** argv) {
+	// number of threads to read maps with, defaults to one per core
+	size_t jobs = 0;
+	// only read maps which changed since the last run
+	bool incremental = false;
+	// write everything read from the maps to a snapshot, or build from a snapshot instead of the maps
+	fs::path saveSnapshotPath, fromSnapshotPath;
+	// hash every map and preview and list the versionconfig.ini entries which need updating
+	bool hashFiles = false;
+	// time every phase and count what was read and looked up, print it at the end and optionally save it as JSON
+	bool showStats = false;
+	fs::path statsJsonPath;
+	size_t statsTop = 10;
+	// keep running after MPMaps.ini is built and rebuild it whenever the maps change
+	bool watch = false;
+	// never read from the console, everything the prompts would ask comes from these instead
+	bool batch = false;
+	fs::path cncnetArg, configArg, baseArg, outputArg;
+	Overwrite overwrite = Overwrite::ask;
+	MissingNames missingNames = MissingNames::ask;
+	// build several trees listed in a file instead of the one in PathsYRMU.ini
+	fs::path treesPath;
+	// fill in maps without a PNG preview from the preview inside the map
+	EmbeddedPreviews embedded = EmbeddedPreviews::ignore;
+	// list what changed since the old MPMaps.ini, and optionally patch it in place
+	DiffOld diffOld = DiffOld::none;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if ((arg == "--jobs" || arg == "-j") && i + 1 < argc)
+			jobs = std::strtoul(argv[++i], nullptr, 10);
+		else if (str_startswith(arg, "--jobs="))
+			jobs = std::strtoul(arg.c_str() + 7, nullptr, 10);
+		else if (arg == "--incremental" || arg == "-i")
+			incremental = true;
+		else if (arg == "--save-snapshot" && i + 1 < argc)
+			saveSnapshotPath = argv[++i];
+		else if (arg == "--from-snapshot" && i + 1 < argc)
+			fromSnapshotPath = argv[++i];
+		else if (arg == "--hash-files")
+			hashFiles = true;
+		else if (arg == "--stats")
+			showStats = true;
+		else if (arg == "--stats-json" && i + 1 < argc) {
+			showStats = true;
+			statsJsonPath = argv[++i];
+		}
+		else if (arg == "--stats-top" && i + 1 < argc)
+			statsTop = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--watch" || arg == "-w")
+			watch = true;
+		else if (arg == "--batch" || arg == "-b")
+			batch = true;
+		else if (arg == "--trees" && i + 1 < argc)
+			treesPath = argv[++i];
+		else if (arg == "--cncnet" && i + 1 < argc)
+			cncnetArg = argv[++i];
+		else if (arg == "--versionconfig" && i + 1 < argc)
+			configArg = argv[++i];
+		else if (arg == "--base" && i + 1 < argc)
+			baseArg = argv[++i];
+		else if (arg == "--output" && i + 1 < argc)
+			outputArg = argv[++i];
+		else if (arg == "--overwrite" && i + 1 < argc) {
+			std::string policy(argv[++i]);
+			if (policy == "replace")
+				overwrite = Overwrite::replace;
+			else if (policy == "keep")
+				overwrite = Overwrite::keep;
+			else {
+				std::cout << "--overwrite must be replace or keep" << std::endl;
+				return EXIT_USAGE;
+			}
+		}
+		else if (arg == "--missing-names" && i + 1 < argc) {
+			std::string policy(argv[++i]);
+			if (policy == "skip")
+				missingNames = MissingNames::skip;
+			else if (policy == "stop")
+				missingNames = MissingNames::stop;
+			else {
+				std::cout << "--missing-names must be skip or stop" << std::endl;
+				return EXIT_USAGE;
+			}
+		}
+		else if (arg == "--diff")
+			diffOld = std::max(diffOld, DiffOld::list);
+		else if (arg == "--patch-old")
+			diffOld = DiffOld::patch;
+		else if (arg == "--embedded-previews" && i + 1 < argc) {
+			std::string mode(argv[++i]);
+			if (mode == "size")
+				embedded = EmbeddedPreviews::size;
+			else if (mode == "extract")
+				embedded = EmbeddedPreviews::extract;
+			else {
+				std::cout << "--embedded-previews must be size or extract" << std::endl;
+				return EXIT_USAGE;
+			}
+		}
+		else {
+			std::cout << "Unknown argument " << arg << std::endl;
+			return EXIT_USAGE;
+		}
+	}
+	// nobody is there to answer, so anything not given is the safe choice
+	if (batch && overwrite == Overwrite::ask)
+		overwrite = Overwrite::keep;
+	if (batch && missingNames == MissingNames::ask)
+		missingNames = MissingNames::stop;
+	// rather than reading every map only to find MPMaps.ini can't be written
+	if (!outputArg.empty() && !fs::is_directory(fs::absolute(outputArg).parent_path())) {
+		std::cout << "Directory " << fs::absolute(outputArg).parent_path().string() << " for --output doesn't exist" << std::endl;
+		return EXIT_USAGE;
+	}
+	ThreadPool pool(jobs);
+	if (!treesPath.empty()) // always runs as a batch
+		return run_trees(pool, treesPath, (overwrite == Overwrite::replace) ? overwrite : Overwrite::keep,
+			(missingNames == MissingNames::skip) ? missingNames : MissingNames::stop, embedded, diffOld);
+	RunStats runStats;
+	RunStats* stats = showStats ? &runStats : nullptr;
+
+	// create PathsYRMU.ini to save required paths if it doesn't already exists,
+	// batch runs only ever read it so several can run side by side
+	if (!batch && !fs::exists(pathsIniPath))
 		std::ofstream(pathsIniPath).close();
 	// prevent it from being moved while the program is running
 	std::ifstream pathsIniPathOpen(pathsIniPath);
 
-	// get cncnet path from PathsYRMU.ini
-	fs::path ptmp1(std::string(buffer, GetPrivateProfileString(
-		"PATHS", "CNCNET", NULLSTR, buffer, BUFFSIZE, pathsIniPath)));
+	// get cncnet path from the arguments or PathsYRMU.ini
+	fs::path ptmp1(cncnetArg.empty() ? fs::path(paths_ini_get("CNCNET")) : cncnetArg);
 	auto ptmp2 = ptmp1 / mapsPathRelative;
-	auto ptmp3 = ptmp1 / "INI\\MPMaps.ini";
+	auto ptmp3 = ptmp1 / "INI" / "MPMaps.ini";
+	if (batch && !(fs::exists(ptmp1) && fs::exists(ptmp2) && fs::exists(ptmp3))) {
+		std::cout << "CnCNet directories not found in \"" << ptmp1.string() << "\", pass the path to CnCNet with --cncnet" << std::endl;
+		return EXIT_USAGE;
+	}
 	if (!(fs::exists(ptmp1) && fs::exists(ptmp2) && fs::exists(ptmp3))) {
 		std::cout << "Enter full path to CnCNet: " << std::endl;
 		std::string newPath;
 		std::getline(std::cin >> std::ws, newPath);
 		ptmp1 = fs::path(newPath);
 		ptmp2 = ptmp1 / mapsPathRelative;
-		ptmp3 = ptmp1 / "INI\\MPMaps.ini";
+		ptmp3 = ptmp1 / "INI" / "MPMaps.ini";
 		while (!(fs::exists(ptmp1) && fs::exists(ptmp2) && fs::exists(ptmp3))) {
 			std::cout << "CnCNet directories not found, enter full path to CnCNet: " << std::endl;
 			std::getline(std::cin >> std::ws, newPath);
 			ptmp1 = fs::path(newPath);
 			ptmp2 = ptmp1 / mapsPathRelative;
-			ptmp3 = ptmp1 / "INI\\MPMaps.ini";
+			ptmp3 = ptmp1 / "INI" / "MPMaps.ini";
 		}
-		WritePrivateProfileString("PATHS", "CNCNET", ptmp1.string(), pathsIniPath);
+		paths_ini_set("CNCNET", ptmp1.string());
 	}
 	const fs::path cncnetPath = ptmp1;
 	const fs::path mapsPathFull = ptmp2;
 	const fs::path mpmapsOldPath = ptmp3;
 
-	// list new maps for versionconfig.ini
-	std::cout << "Would like to create a list of new maps and previews? [y/N] ";
-	if (get_yes_no()) {
-		// get versionconfig.ini path from PathsYRMU.ini
-		fs::path configPath(std::string(buffer, GetPrivateProfileString(
-			"PATHS", "VCONFIG", NULLSTR, buffer, BUFFSIZE, pathsIniPath)));
-		if (!(fs::exists(configPath) && configPath.filename() == "versionconfig.ini")) {
+	// read the old MPMaps.ini once, both the naming pass and the build pass look things up in it
+	const IniDocument mpmapsOld = [&] {
+		PhaseTimer timer(stats, "old MPMaps.ini");
+		return IniDocument(mpmapsOldPath);
+	}();
+
+	// when building from a snapshot, everything about the map tree comes from it and the tree isn't touched
+	SnapshotReader snapshot;
+	const bool useSnapshot = !fromSnapshotPath.empty();
+	if (useSnapshot) {
+		std::string error;
+		if (!snapshot.open(fromSnapshotPath, error)) {
+			std::cout << "Unable to use snapshot " << fromSnapshotPath.string() << ": " << error << std::endl;
+			return EXIT_ERROR;
+		}
+		std::cout << "Using snapshot of " << snapshot.map_count() << " maps from " << fromSnapshotPath.string() << std::endl;
+	}
+
+	// every map and preview, found with a single walk of the tree or taken from the snapshot
+	FileInventory inventory;
+	{
+		PhaseTimer timer(stats, "scan");
+		if (useSnapshot) {
+			for (size_t i = 0; i < snapshot.file_count(); ++i)
+				inventory.add(snapshot.file(i), FileStamp(), str_endswith(std::string(snapshot.file(i)), ".map"));
+			inventory.pair_previews();
+		}
+		else {
+			inventory.scan(cncnetPath, mapsPathFull);
+		}
+	}
+
+	// everything is written next to MPMaps.ini
+	const fs::path mpmapsPath = outputArg.empty() ? program_path() / "MPMaps.ini" : fs::absolute(outputArg);
+	const fs::path outputDir = mpmapsPath.parent_path();
+
+	// list new maps for versionconfig.ini, in batch mode only when given a versionconfig.ini to compare with
+	bool listNew = batch && !configArg.empty();
+	if (!batch) {
+		std::cout << "Would like to create a list of new maps and previews? [y/N] ";
+		listNew = get_yes_no();
+	}
+	if (listNew) {
+		// get versionconfig.ini path from the arguments or PathsYRMU.ini
+		fs::path configPath(configArg.empty() ? fs::path(paths_ini_get("VCONFIG")) : configArg);
+		if (batch && !fs::exists(configPath)) {
+			std::cout << "Unable to find " << configPath.string() << std::endl;
+			return EXIT_USAGE;
+		}
+		if (!batch && !(fs::exists(configPath) && configPath.filename() == "versionconfig.ini")) {
 			std::cout << "Enter full path to versionconfig.ini:" << std::endl;
 			std::string newPath;
 			std::getline(std::cin >> std::ws, newPath);
@@ -232,74 +601,150 @@ int main(int argc, const char** argv) {
 				std::getline(std::cin >> std::ws, newPath);
 				configPath = fs::path(newPath);
 			}
-			WritePrivateProfileString("PATHS", "VCONFIG", configPath.string(), pathsIniPath);
+			paths_ini_set("VCONFIG", configPath.string());
 		}
-		std::ifstream config(configPath);
-
-		// read map and preview entries from config into a vector
-		std::vector<std::string> configEntries;
-		std::string line;
-		while (std::getline(config, line))
-			if (str_startswith(line, mapsPathRelative.string()))
-				configEntries.push_back(line);
-		config.close();
+		PhaseTimer timer(stats, "versionconfig");
+		// read map and preview entries from config, and describe every map and preview the same way
+		std::vector<VersionEntry> versionEntries = read_versionconfig(configPath, mapsPathRelative.string());
+		std::vector<VersionEntry> treeEntries(inventory.size());
+		for (size_t i = 0; i < inventory.size(); ++i) {
+			treeEntries[i].path = inventory.path(i);
+			std::replace(treeEntries[i].path.begin(), treeEntries[i].path.end(), '/', '\\'); // as the updater writes them
+			treeEntries[i].size = versionconfig_size(inventory.file(i).stamp.size);
+		}
+		// hashing is what catches content changes which keep the size, but it reads every file
+		if (hashFiles && useSnapshot) {
+			std::cout << "Files can't be hashed from a snapshot, skipping versionconfig.ini hashes" << std::endl;
+		}
+		else if (hashFiles) {
+			bool upperCase = versionconfig_upper_case(versionEntries);
+			std::cout << "Hashing " << inventory.size() << " maps and previews..." << std::endl;
+			pool.parallel_for(inventory.size(), [&](size_t i, size_t) {
+				uint64_t size;
+				treeEntries[i].hash = sha1_file(cncnetPath / inventory.path(i), size, upperCase);
+				treeEntries[i].size = versionconfig_size(size);
+			});
+		}
+		VersionDiff diff = diff_versionconfig(versionEntries, treeEntries, !useSnapshot);
 
-		// read all maps, output to file if not in config entries
-		fs::path outPath = path_check_exists(program_path(), "versionconfig_missing.txt");
+		// output maps and previews to file if not in config entries
+		fs::path outPath = path_check_exists(outputDir, "versionconfig_missing.txt", overwrite);
+		if (outPath.empty())
+			return EXIT_EXISTS;
 		std::ofstream newMaps(outPath);
-		for (const auto& e : fs::recursive_directory_iterator(mapsPathFull)) {
-			fs::path dirEntry = e.path();
-			if (dirEntry.extension() == ".map" or dirEntry.extension() == ".png") {
-				std::string newEntryCandidate = str_cutends(
-					dirEntry.string(), cncnetPath.string().length() + 1, 0); // remove cncnetPath from this path
-				if (std::find(configEntries.begin(), configEntries.end(), newEntryCandidate) == configEntries.end())
-					newMaps << newEntryCandidate << std::endl; // candidate is not in config entries, write it
-			}
-		}
+		for (const VersionEntry& e : diff.missing)
+			newMaps << e.path << std::endl;
 		newMaps.close();
 		std::cout << "Created list of new maps and previews in " << outPath.string() << std::endl;
+		std::cout << diff.missing.size() << " missing, " << diff.stale.size() << " stale, " << diff.orphaned.size()
+			<< " orphaned and " << diff.current << " current versionconfig.ini entries" << std::endl;
+
+		if (hashFiles && !useSnapshot) {
+			fs::path diffPath = path_check_exists(outputDir, "versionconfig_changes.txt", overwrite);
+			if (diffPath.empty())
+				return EXIT_EXISTS;
+			std::ofstream diffOut(diffPath);
+			write_versionconfig_diff(diffOut, diff);
+			diffOut.close();
+			std::cout << "Wrote versionconfig.ini entries to update to " << diffPath.string() << std::endl;
+		}
 	}
 
-	// getting everything we need for MPMaps
-	const fs::path mpmapsPath = program_path() / "MPMaps.ini";
-
-	// read map names and paths into an std::map to sort by player number, followed by map title
-	// if we can't find the name for any map, write all maps with missing names to a file
-	std::map<std::string, fs::path> mapPathsOrdered;
-	std::vector<std::string> missing;
-	const std::basic_regex titlePattern("^\\[\\d\\] \\S.+$"); // regex for map names
-	for (const auto& e : fs::recursive_directory_iterator(mapsPathFull)) {
-		fs::path dirEntry = e.path();
-		if (dirEntry.extension() == ".map") {
-			// start looking for the name in the map itself
-			std::string mapTitle(buffer, GetPrivateProfileString(
-				"Basic", "Name", NULLSTR, buffer, BUFFSIZE, dirEntry));
-			if (std::regex_match(mapTitle, titlePattern)) {
-				mapPathsOrdered[mapTitle + dirEntry.string()] = dirEntry; // add directory to key in case maps have the same name
-				continue;
+	MapSet maps;
+	if (useSnapshot) {
+		PhaseTimer timer(stats, "read snapshot");
+		maps = snapshot_maps(snapshot);
+		if (embedded != EmbeddedPreviews::ignore)
+			std::cout << "Maps can't be read from a snapshot, using the previews saved in it" << std::endl;
+	}
+	else {
+		// in incremental mode, maps which haven't changed since the last run are taken from the cache instead
+		MapCache mapCache;
+		if (incremental && !mapCache.load(mapCachePath))
+			std::cout << "No usable map cache found, reading all maps" << std::endl;
+		std::cout << "Reading " << inventory.maps().size() << " maps..." << std::endl;
+		time_t lastPrintTime = time(0); // timer for printing progress bar
+		{
+			PhaseTimer timer(stats, "read maps");
+			SharedMaps shared;
+			maps = read_maps(pool, inventory, cncnetPath, mapCache, shared, [&](size_t mapsRead) {
+				// print progress bar every few seconds
+				if (difftime(time(0), lastPrintTime) >= 3) {
+					std::cout << progress_to_string(mapsRead, inventory.maps().size(), 70) << std::endl;
+					lastPrintTime = time(0);
+				}
+			}, stats);
+		}
+		{
+			PhaseTimer timer(stats, "read previews");
+			read_previews(pool, maps, cncnetPath);
+		}
+		if (incremental)
+			std::cout << "Reused " << maps.reused << " unchanged maps from the cache" << std::endl;
+
+		// identical maps are only read once, but they're worth knowing about so the copies can be pruned
+		std::vector<std::vector<size_t>> duplicates = duplicate_maps(maps);
+		if (!duplicates.empty()) {
+			size_t copies = 0;
+			for (const std::vector<size_t>& group : duplicates)
+				copies += group.size() - 1;
+			std::cout << "Found " << copies << " copies of " << duplicates.size() << " maps"
+				<< (stats ? "" : ", run with --stats to list them") << std::endl;
+		}
+		if (stats) {
+			for (const std::vector<size_t>& group : duplicates) {
+				std::vector<std::string>& keys = stats->duplicates.emplace_back();
+				for (size_t i : group)
+					keys.push_back(maps.keys[i]);
 			}
+		}
 
-			// valid name not found in map, fall back on old MPMaps.ini
-			// remove parts of path not included in MPMaps section name
-			std::string mapSection = str_cutends(
-				dirEntry.string(), cncnetPath.string().length() + 1, 4);
-			// get new map name and validate
-			std::string mapTitleMP(buffer, GetPrivateProfileString(
-				mapSection, "Description", NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-			if (std::regex_match(mapTitleMP, titlePattern)) {
-				mapPathsOrdered[mapTitleMP + dirEntry.string()] = dirEntry;
-				continue;
-			}
+		// save what we read for the next incremental run, maps which were deleted drop out here,
+		// other runs leave the cache alone so they can run side by side
+		if (incremental || watch) {
+			PhaseTimer timer(stats, "save cache");
+			cache_maps(mapCache, maps);
+			if (!mapCache.save_replace(mapCachePath))
+				std::cout << "Unable to write " << mapCachePath.string() << std::endl;
+		}
 
-			// valid name not found in MPMaps.ini, push to missing name vector
-			missing.push_back(
-				mapSection + "\nname in map was " + ((mapTitle == NULLSTR) ? "not found" : mapTitle) +
-				", name in MPMaps.ini was " + ((mapTitleMP == NULLSTR) ? "not found" : mapTitleMP) + '\n');
+		// after saving the cache, so the cache only ever holds what's in the files themselves
+		if (embedded != EmbeddedPreviews::ignore) {
+			PhaseTimer timer(stats, "previews in maps");
+			size_t filled = read_embedded_previews(pool, maps, cncnetPath, embedded);
+			if (embedded == EmbeddedPreviews::extract)
+				std::cout << "Extracted " << filled << " previews from maps without a PNG" << std::endl;
+			else
+				std::cout << "Took the preview size of " << filled << " maps without a PNG from the maps themselves" << std::endl;
+		}
+
+		if (!saveSnapshotPath.empty()) {
+			PhaseTimer timer(stats, "save snapshot");
+			std::vector<const MapData*> mapData;
+			for (const MapCache::Entry& e : maps.entries)
+				mapData.push_back(&e.data);
+			std::vector<std::string> treeFiles;
+			for (size_t i = 0; i < inventory.size(); ++i)
+				treeFiles.emplace_back(inventory.path(i));
+			if (write_snapshot(saveSnapshotPath, maps.rootPrefix, maps.keys, mapData, treeFiles))
+				std::cout << "Saved snapshot of " << mapData.size() << " maps to " << saveSnapshotPath.string() << std::endl;
+			else
+				std::cout << "Unable to write " << saveSnapshotPath.string() << std::endl;
 		}
 	}
+
+	// sort map names and paths by player number, followed by map title
+	// if we can't find the name for any map, write all maps with missing names to a file
+	MapNames names = [&] {
+		PhaseTimer timer(stats, "naming");
+		return name_maps(pool, maps, mpmapsOld);
+	}();
+	const std::vector<std::string>& missing = names.missing;
 	if (!missing.empty()) { // if any maps were missing names, write them all to a file
 		std::cout << "Unable to find valid names for " << missing.size() << " maps" << std::endl;
-		fs::path outPath = path_check_exists(program_path(), "map_names_missing.txt");
+		fs::path outPath = path_check_exists(outputDir, "map_names_missing.txt", overwrite);
+		if (outPath.empty())
+			return EXIT_EXISTS;
 		std::ofstream missingMaps(outPath);
 		for (const std::string& s : missing)
 			missingMaps << s << std::endl;
@@ -307,208 +752,97 @@ int main(int argc, const char** argv) {
 		missingMaps.close();
 
 		// give user the option to abort
-		std::cout << "Would you like to continue? Maps with missing names will not be processed [y/N] ";
-		if (!get_yes_no())
-			return 0;
+		if (missingNames == MissingNames::ask) {
+			std::cout << "Would you like to continue? Maps with missing names will not be processed [y/N] ";
+			missingNames = get_yes_no() ? MissingNames::skip : MissingNames::stop;
+		}
+		if (missingNames == MissingNames::stop)
+			return EXIT_MISSING_NAMES;
 	}
 
-	// copy MPMapsBase.ini, this copy is where we'll write all the info we get
-	fs::path mpmapsBasePath = program_path() / "MPMapsBase.ini";
-	while (!fs::exists(mpmapsBasePath) || mpmapsBasePath.filename() != "MPMapsBase.ini") {
+	// start from MPMapsBase.ini, everything we get is added to this in memory and written out at the end
+	fs::path mpmapsBasePath = baseArg.empty() ? program_path() / "MPMapsBase.ini" : baseArg;
+	if (batch && !fs::exists(mpmapsBasePath)) {
+		std::cout << "Unable to find " << mpmapsBasePath.string() << ", pass the path to MPMapsBase.ini with --base" << std::endl;
+		return EXIT_USAGE;
+	}
+	while (!fs::exists(mpmapsBasePath) || (baseArg.empty() && mpmapsBasePath.filename() != "MPMapsBase.ini")) {
 		std::cout << "Unable to find MPMapsBase.ini, please enter full path:" << std::endl;
 		std::string inputTemp;
 		std::getline(std::cin >> std::ws, inputTemp);
 		mpmapsBasePath = fs::path(inputTemp);
 	}
-	if (fs::exists(mpmapsPath)) {
+	if (fs::exists(mpmapsPath) && overwrite == Overwrite::keep) {
+		std::cout << mpmapsPath.string() << " already exists" << std::endl;
+		return EXIT_EXISTS;
+	}
+	if (fs::exists(mpmapsPath) && overwrite == Overwrite::ask) {
 		std::cout << mpmapsPath.string() << " already exists, would you like to delete it? [y/N] ";
-		if (get_yes_no())
-			fs::remove(mpmapsPath);
-		else
-			return 0;
+		if (!get_yes_no())
+			return EXIT_EXISTS;
 	}
-	fs::copy(mpmapsBasePath, mpmapsPath);
-
-	// HERE WE GO, BITCHES!!!!!!
-	std::cout << "Building MPMaps.ini..." << std::endl;
-	std::vector<std::string> notes; // save notes on whatever was found missing to this, append them all to the end of MPMaps as comments when it's done building
-
-	// go through each map, add to [MultiMaps], and collect info for their individual sections
-	int multiMapsIndex = 0;
-	const std::basic_regex badBriefPattern("^Brief:(ALL|TRN)\\d{2}(md)?$"); // regex for bad briefings
-	time_t lastPrintTime = time(0); // timer for printing progress bar
-	for (auto const& [key, mapPath] : mapPathsOrdered) {
-		// print progress bar every few seconds
-		if (difftime(time(0), lastPrintTime) >= 3) {
-			std::cout << progress_to_string(multiMapsIndex, mapPathsOrdered.size(), 70) << std::endl;
-			lastPrintTime = time(0);
-		}
-
-		// write MultiMaps entry
-		std::string mapSection = str_cutends(mapPath.string(), cncnetPath.string().length() + 1, 4);
-		WritePrivateProfileString("MultiMaps", std::to_string(multiMapsIndex++), mapSection, mpmapsPath);
-
-		// write map name (can be taken from key by removing directory)
-		std::string mapTitle = str_cutends(key, 0, mapPath.string().length());
-		WritePrivateProfileString(mapSection, "Description", mapTitle, mpmapsPath);
-
-		// write author, prioritize old MPMaps for this one so maps don't need authors updated individually
-		std::string mapAuthor(buffer, GetPrivateProfileString(mapSection, "Author", NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-		if (mapAuthor == NULLSTR) {
-			// author not in old MPMaps, check map
-			mapAuthor = std::string(buffer, GetPrivateProfileString("Basic", "Author", NULLSTR, buffer, BUFFSIZE, mapPath));
-			if (mapAuthor == NULLSTR) {
-				// author not in old MPMaps, set defaut and make note
-				notes.push_back("; " + mapSection + " missing Author, set to \"Unknown Author\"");
-				mapAuthor = "Unknown Author";
-			}
-		}
-		WritePrivateProfileString(mapSection, "Author", mapAuthor, mpmapsPath);
-
-		// write briefing if we can find it
-		std::string mapBrief(buffer, GetPrivateProfileString("Basic", "Briefing", NULLSTR, buffer, BUFFSIZE, mapPath));
-		if (mapBrief == NULLSTR || std::regex_match(mapBrief, badBriefPattern)) // valid briefing not in map, check old MPMaps
-			mapBrief = std::string(buffer, GetPrivateProfileString(mapSection, "Briefing", NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-		if (mapBrief != NULLSTR)
-			WritePrivateProfileString(mapSection, "Briefing", mapBrief, mpmapsPath);
-
-		// write gamemodes, prioritize old MPMaps for this one 'cause lots of maps don't have the correct gamemodes set
-		std::string mapModes(buffer, GetPrivateProfileString(
-			mapSection, "GameModes", NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-		if (mapModes == NULLSTR) // gamemodes not found in old MPMapsn check map
-			mapModes = std::string(buffer, GetPrivateProfileString(
-				"Basic", "GameMode", NULLSTR, buffer, BUFFSIZE, mapPath));
-		if (mapModes == NULLSTR) { // gamemodes not found in map, set default and make note
-			notes.push_back("; " + mapSection + " missing GameModes, set to \"Battle\"");
-			mapModes = "Battle";
-		}
-		// when writing, replace "standard" with "battle", then capitalize each word
-		size_t pos = mapModes.find("standard");
-		if (pos != std::string::npos)
-			mapModes.replace(pos, 8, "battle");
-		mapModes = str_titlecase(mapModes);
-		WritePrivateProfileString(mapSection, "GameModes", mapModes, mpmapsPath);
-
-		// write coop info if map is coop, check map and MPMaps for IsCoopMission
-		std::string mapCoopVal(buffer, GetPrivateProfileString(
-			"Basic", "IsCoopMission", NULLSTR, buffer, BUFFSIZE, mapPath));
-		std::transform(mapCoopVal.begin(), mapCoopVal.end(), mapCoopVal.begin(), std::tolower);
-		std::string iniCoopVal(buffer, GetPrivateProfileString(
-			mapSection, "IsCoopMission", NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-		std::transform(iniCoopVal.begin(), iniCoopVal.end(), iniCoopVal.begin(), std::tolower);
-		std::vector<int> coopEnemyWaypnts; // we need a list of waypoints the player can't choose when we write starting waypoints
-		if (eqor(mapCoopVal, "yes", "true") || eqor(iniCoopVal, "yes", "true")) {
-			// regex for enemy house entry values
-			const std::basic_regex enemyHousePattern("^(\\d+,\\d+,\\d+)\\s*;?.*$");
-			
-			// duh
-			WritePrivateProfileString(mapSection, "IsCoopMission", "yes", mpmapsPath);
-
-			// write sides and colors player is now allowed to choose
-			for (std::string bannedKey : {"DisallowedPlayerSides", "DisallowedPlayerColors"}) {
-				std::string mapBannedItems(buffer, GetPrivateProfileString(
-					"Basic", bannedKey, NULLSTR, buffer, BUFFSIZE, mapPath));
-				if (mapBannedItems == NULLSTR)
-					mapBannedItems = std::string(buffer, GetPrivateProfileString(
-						mapSection, bannedKey, NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-				if (mapBannedItems == NULLSTR) {
-					notes.push_back("; " + mapSection + " missing " + bannedKey);
-				}
-				else {
-					WritePrivateProfileString(mapSection, bannedKey, mapBannedItems, mpmapsPath);
-				}
-			}
-
-			// write enemy house info
-			size_t enemyHouseNum = 0;
-			bool useMP = false;
-			std::string mapEnemyHouse(buffer, GetPrivateProfileString(
-				"Basic", "EnemyHouse" + std::to_string(enemyHouseNum), NULLSTR, buffer, BUFFSIZE, mapPath));
-			if (!std::regex_match(mapEnemyHouse, enemyHousePattern)) {
-				useMP = true;
-				mapEnemyHouse = std::string(buffer, GetPrivateProfileString(
-					mapSection, "EnemyHouse" + std::to_string(enemyHouseNum), NULLSTR, buffer, BUFFSIZE, mpmapsOldPath));
-			}
-			if (!std::regex_match(mapEnemyHouse, enemyHousePattern)) {
-				notes.push_back("; " + mapSection + " missing EnemyHouse entries (this has affected Waypoint entires as well)");
-			}
-			else {
-				while (enemyHouseNum <= 8 && mapEnemyHouse != NULLSTR) {
-					// strip comment from mapEnemyHouse if there is one,
-					// we need the last character to be the waypoint for the enemy house
-					auto mapEnemyHouseStripped = std::regex_replace(mapEnemyHouse, enemyHousePattern, "$1");
-					// last character of mapEnemyHouseStripped is the waypoint for the enemy house
-					coopEnemyWaypnts.push_back(mapEnemyHouseStripped[mapEnemyHouseStripped.size() - 1] - '0');
-					WritePrivateProfileString(
-						mapSection, "EnemyHouse" + std::to_string(enemyHouseNum++), mapEnemyHouse, mpmapsPath);
-					mapEnemyHouse = (useMP) ?
-						std::string(buffer, GetPrivateProfileString(
-							mapSection, "EnemyHouse" + std::to_string(enemyHouseNum), NULLSTR, buffer, BUFFSIZE, mpmapsOldPath)) :
-						std::string(buffer, GetPrivateProfileString(
-							"Basic", "EnemyHouse" + std::to_string(enemyHouseNum), NULLSTR, buffer, BUFFSIZE, mapPath));
-				}
-			}
-		}
-
-		// write min/max players, EnforceMaxPlayers and starting waypoints, base on coop info if map is coop
-		size_t itterWaypnt = 0;
-		std::string mapWaypnt(buffer, GetPrivateProfileString(
-			"Waypoints", std::to_string(itterWaypnt), NULLSTR, buffer, BUFFSIZE, mapPath));
-		while (itterWaypnt <= 8 && mapWaypnt != NULLSTR) {
-			// only write if this waypoint doesn't belong to an enemy in coop
-			if (std::find(coopEnemyWaypnts.begin(), coopEnemyWaypnts.end(), itterWaypnt) == coopEnemyWaypnts.end())
-				WritePrivateProfileString(
-					mapSection, "Waypoint" + std::to_string(itterWaypnt), mapWaypnt, mpmapsPath);
-			++itterWaypnt;
-			mapWaypnt = std::string(buffer, GetPrivateProfileString(
-				"Waypoints", std::to_string(itterWaypnt), NULLSTR, buffer, BUFFSIZE, mapPath));
-		}
-		WritePrivateProfileString(mapSection, "MinPlayers", "2", mpmapsPath);
-		WritePrivateProfileString(
-			mapSection, "MaxPlayers", std::to_string(itterWaypnt - coopEnemyWaypnts.size()), mpmapsPath);
-		WritePrivateProfileString(mapSection, "EnforceMaxPlayers", "True", mpmapsPath);
-
-		// get ForcedOptions and ForcedSpawnIniOptions from map,
-		// write it as ForcedOptions-mapname or ForcedSpawnIniOptions-mapname in MPMaps
-		for (std::string forcedKey : {"ForcedOptions", "ForcedSpawnIniOptions"}) {
-			if (GetPrivateProfileSection(forcedKey, buffer, BUFFSIZE, mapPath)) {
-				std::string forcedOptionsName = forcedKey + '-' + mapSection;
-				WritePrivateProfileString(mapSection, forcedKey, forcedOptionsName, mpmapsPath);
-				WritePrivateProfileSection(forcedOptionsName, buffer, mpmapsPath);
-			}
-		}
-
-		// write map sizes and preview size
-		WritePrivateProfileString(mapSection, "Size", std::string(buffer, GetPrivateProfileString(
-			"Map", "Size", NULLSTR, buffer, BUFFSIZE, mapPath)), mpmapsPath);
-		WritePrivateProfileString(mapSection, "LocalSize", std::string(buffer, GetPrivateProfileString(
-			"Map", "LocalSize", NULLSTR, buffer, BUFFSIZE, mapPath)), mpmapsPath);
-		std::pair<int, int> mapPreviewSize;
-		try {
-			auto mapPreviewSize = png_getsize(fs::path(mapPath).replace_extension(".png"));
-			WritePrivateProfileString(mapSection, "PreviewSize",
-				std::to_string(mapPreviewSize.first) + ',' + std::to_string(mapPreviewSize.second), mpmapsPath);
-		}
-		catch (std::invalid_argument) { // couldn't find png preview, make note
-			notes.push_back("; " + mapSection + " missing PreviewSize");
+	IniWriter mpmaps;
+	size_t notes;
+	{
+		PhaseTimer timer(stats, "build");
+		mpmaps.load(mpmapsBasePath);
+
+		// HERE WE GO, BITCHES!!!!!!
+		std::cout << "Building MPMaps.ini..." << std::endl;
+		notes = build_mpmaps(mpmaps, pool, maps, names, mpmapsOld, stats);
+	}
+	{
+		PhaseTimer timer(stats, "write");
+		if (!mpmaps.save_replace(mpmapsPath)) {
+			std::cout << "Unable to write " << mpmapsPath.string() << std::endl;
+			return EXIT_ERROR;
 		}
 	}
-
-	// add comments to the end of the new MPMaps listing all entries which are missing
-	std::ofstream out(mpmapsPath, std::ofstream::app);
-	for (const std::string& s : notes)
-		out << s << std::endl;
-	out.close();
+	if (diffOld != DiffOld::none) {
+		PhaseTimer timer(stats, "diff");
+		int result = diff_old_mpmaps(mpmaps, mpmapsOld, mpmapsOldPath, outputDir, diffOld, overwrite);
+		if (result != EXIT_OK)
+			return result;
+	}
 
 	// tell the user we're done
 	std::cout << "MPMaps.ini has been built";
-	if (!notes.empty())
+	if (notes > 0)
 		std::cout << ", notes on missing data were written to the end of the file";
 	std::cout << std::endl;
+	std::cout << "Scanned " << maps.stats.files << " maps, looked at " << maps.stats.bytesRead / 1024 << " of "
+		<< maps.stats.bytesTotal / 1024 << " KB and skipped " << maps.stats.bytes_skipped() / 1024 << " KB without parsing";
+	if (maps.stats.bytesHashed > 0)
+		std::cout << ", hashed " << maps.stats.bytesHashed / 1024 << " KB of maps the same size as another";
+	std::cout << std::endl;
+	if (stats) {
+		stats->maps = maps.keys.size();
+		stats->mapsRead = maps.stats.files;
+		stats->mapBytesTotal = maps.stats.bytesTotal;
+		stats->mapBytesRead = maps.stats.bytesRead;
+		stats->mapBytesHashed = maps.stats.bytesHashed;
+		stats->mpmapsOldBytes = mpmapsOld.size();
+		stats->previewsRead = maps.previewsRead;
+		stats->previewBytesRead = maps.previewsRead * pngHeaderSize;
+		stats->lookups += names.lookups;
+		stats->fallbacks += names.lookups;
+		stats->notes = notes;
+		stats->find_slowest(maps.keys, statsTop);
+		stats->print(std::cout);
+		if (!statsJsonPath.empty() && !stats->save_json(statsJsonPath))
+			std::cout << "Unable to write " << statsJsonPath.string() << std::endl;
+	}
+
+	if (watch && useSnapshot)
+		std::cout << "Maps can't be watched when building from a snapshot" << std::endl;
+	else if (watch)
+		watch_maps(pool, cncnetPath, mapsPathFull, mpmapsOldPath, mpmapsBasePath, mpmapsPath, embedded, std::move(maps));
 
 	// wait for input to return success
-	std::cout << "Press [Enter] to exit" << std::endl;
-	std::cin.get();
+	if (!batch) {
+		std::cout << "Press [Enter] to exit" << std::endl;
+		std::cin.get();
+	}
 	pathsIniPathOpen.close();
-	return 0;
+	return EXIT_OK;
 }
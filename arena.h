@@ -0,0 +1,99 @@
+/**
+ * @file arena.h
+ * @brief Bump allocator for the short strings built for every map.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * Strings which live as long as the arena, carved out of large blocks so a
+ * map's entries can be built without an allocation for every string. An arena
+ * isn't thread safe, each worker gets its own.
+ */
+class StringArena {
+public:
+	/**
+	 * Start an empty arena, nothing is allocated until the first string.
+	 *
+	 * @param blockSize size of each block strings are carved out of.
+	 */
+	explicit StringArena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+	/**
+	 * Reserve space for a string.
+	 *
+	 * @param n number of characters.
+	 * @return pointer to the space, valid as long as the arena.
+	 */
+	char* allocate(size_t n) {
+		if (n > left) {
+			size_t size = std::max(n, blockSize);
+			blocks.emplace_back(new char[size]);
+			next = blocks.back().get();
+			left = size;
+		}
+		char* p = next;
+		next += n;
+		left -= n;
+		return p;
+	}
+
+	/**
+	 * Copy a string into the arena.
+	 *
+	 * @param s string to copy.
+	 * @return the copy.
+	 */
+	std::string_view copy(std::string_view s) {
+		char* p = allocate(s.size());
+		std::memcpy(p, s.data(), s.size());
+		return std::string_view(p, s.size());
+	}
+
+	/**
+	 * Join strings into one in the arena.
+	 *
+	 * @param parts strings to join, in order.
+	 * @return the joined string.
+	 */
+	std::string_view concat(std::initializer_list<std::string_view> parts) {
+		size_t size = 0;
+		for (std::string_view part : parts)
+			size += part.size();
+		char* p = allocate(size);
+		char* at = p;
+		for (std::string_view part : parts) {
+			std::memcpy(at, part.data(), part.size());
+			at += part.size();
+		}
+		return std::string_view(p, size);
+	}
+
+	/**
+	 * Write an integer into the arena, the same as std::to_string.
+	 *
+	 * @param n integer to write.
+	 * @return the integer as text.
+	 */
+	template <class Int>
+	std::string_view number(Int n) {
+		char buf[24];
+		std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), n);
+		return copy(std::string_view(buf, size_t(r.ptr - buf)));
+	}
+
+private:
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* next = nullptr;
+	size_t left = 0; // bytes left in the last block
+	size_t blockSize;
+};
@@ -0,0 +1,103 @@
+/**
+ * @file patterns_bench.cpp
+ * @brief Compares the matchers in patterns.h against the std::regex patterns they replaced.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+#include "../patterns.h"
+
+// the patterns as they were used before patterns.h
+const std::regex titlePattern("^\\[\\d\\] \\S.+$");
+const std::regex badBriefPattern("^Brief:(ALL|TRN)\\d{2}(md)?$");
+const std::regex enemyHousePattern("^(\\d+,\\d+,\\d+)\\s*;?.*$");
+
+// names, briefings and EnemyHouse values as they appear in maps and MPMaps.ini, good and bad
+const std::vector<std::string> titles = {
+	"[2] Dry Heat", "[2] Heck Freezes Over", "[4] Little Big Lake", "[4] Pinch Point", "[6] Dustbowl",
+	"[8] Blitzkrieg!", "[8] Golden State Freeway", "[3] Cold War Co-op", "[4] Mission: Alcatraz",
+	"[2] Isle of War (YR)", "[8] Malibu Cliffs", "[6] Sinkhole", "[2] Near Ore Far", "[4] Loop Hole",
+	"[5] Streets of Gold", "[8] Ice Age", "[2] Tour of Egypt",
+	"[4]  Double Space", "[4]", "[4] x", "[10] Too Many", "[a] Letter", "4] Broken", "[4]\tTab",
+	"[4] Line\nBreak", "[4] Carriage\r", "Unnamed", "", "[8] Oasis ",
+};
+const std::vector<std::string> briefings = {
+	"Brief:ALL01", "Brief:ALL12md", "Brief:TRN03", "Brief:TRN10md", "Brief:SOV01", "Brief:ALL1",
+	"Brief:ALL012", "Brief:ALL01m", "Brief:ALL01mdx", "brief:ALL01",
+	"Defend the base until reinforcements arrive.@@Destroy all enemy structures.",
+	"Capture the oil derricks and hold them.", "", "Brief:",
+};
+const std::vector<std::string> enemyHouses = {
+	"0,1,2", "2,6,4", "1,3,5 ;Allied, blue, waypoint 5", "9,0,7;", "3,2,1   ", "10,12,7 ; soviet",
+	"4,5,6\n", "4,5,6\nx", "4,5,6 \r ", "1,2", "1,2,", ",1,2,3", "a,b,c", "1, 2, 3", "7,7,7x", "",
+};
+
+/**
+ * Time a matcher over a corpus.
+ *
+ * @param name name to print the result under.
+ * @param corpus strings to match.
+ * @param rounds number of times to go over the corpus.
+ * @param fn matcher to time, returning something to keep the work from being optimized away.
+ * @return nanoseconds per string.
+ */
+template <class Fn>
+double bench(const char* name, const std::vector<std::string>& corpus, size_t rounds, Fn&& fn) {
+	size_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < rounds; ++r)
+		for (const std::string& s : corpus)
+			sink += fn(s);
+	auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	double perString = ns / double(rounds * corpus.size());
+	std::cout << "  " << name << ": " << perString << " ns/string (" << sink << ")" << std::endl;
+	return perString;
+}
+
+int main(int argc, const char** argv) {
+	size_t rounds = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 20000;
+
+	// the matchers have to agree with the patterns on every string before timing means anything
+	int mismatches = 0;
+	auto check = [&](const std::string& s, bool expected, bool actual, const char* what) {
+		if (expected != actual) {
+			std::cout << "MISMATCH " << what << ": \"" << s << "\"" << std::endl;
+			++mismatches;
+		}
+	};
+	for (const std::string& s : titles)
+		check(s, std::regex_match(s, titlePattern), match_map_title(s), "title");
+	for (const std::string& s : briefings)
+		check(s, std::regex_match(s, badBriefPattern), match_bad_briefing(s), "briefing");
+	for (const std::string& s : enemyHouses) {
+		check(s, std::regex_match(s, enemyHousePattern), match_enemy_house(s), "enemy house");
+		check(s, true, std::regex_replace(s, enemyHousePattern, "$1") == strip_enemy_house(s), "enemy house strip");
+	}
+	if (mismatches > 0)
+		return 1;
+
+	std::cout << "title (" << titles.size() << " strings, " << rounds << " rounds)" << std::endl;
+	double a = bench("std::regex", titles, rounds, [](const std::string& s) { return std::regex_match(s, titlePattern); });
+	double b = bench("patterns.h", titles, rounds, [](const std::string& s) { return match_map_title(s); });
+	std::cout << "  speedup: " << a / b << "x" << std::endl;
+
+	std::cout << "briefing (" << briefings.size() << " strings, " << rounds << " rounds)" << std::endl;
+	a = bench("std::regex", briefings, rounds, [](const std::string& s) { return std::regex_match(s, badBriefPattern); });
+	b = bench("patterns.h", briefings, rounds, [](const std::string& s) { return match_bad_briefing(s); });
+	std::cout << "  speedup: " << a / b << "x" << std::endl;
+
+	std::cout << "enemy house match and strip (" << enemyHouses.size() << " strings, " << rounds << " rounds)" << std::endl;
+	a = bench("std::regex", enemyHouses, rounds, [](const std::string& s) {
+		return std::regex_match(s, enemyHousePattern) + std::regex_replace(s, enemyHousePattern, "$1").size();
+	});
+	b = bench("patterns.h", enemyHouses, rounds, [](const std::string& s) {
+		return match_enemy_house(s) + strip_enemy_house(s).size();
+	});
+	std::cout << "  speedup: " << a / b << "x" << std::endl;
+	return 0;
+}
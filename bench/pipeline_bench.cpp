@@ -0,0 +1,444 @@
+/**
+ * @file pipeline_bench.cpp
+ * @brief Times each stage of building MPMaps.ini on a synthetic map tree and checks the output never changes.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include "../inidiff.h"
+#include "../inidocument.h"
+#include "../iniwriter.h"
+#include "../inventory.h"
+#include "../mapcache.h"
+#include "../mpmaps.h"
+#include "../platform.h"
+#include "../snapshot.h"
+#include "../threadpool.h"
+#include "../versionconfig.h"
+#include "synthtree.h"
+
+namespace fs = std::filesystem;
+
+#ifndef YRMU_SOURCE_DIR
+#define YRMU_SOURCE_DIR "."
+#endif
+
+// every allocation made anywhere in the benchmark, counted by the operators new below
+static std::atomic<uint64_t> allocations{ 0 };
+
+// kept out of line, so the compiler never pairs a free() here with a new it inlined somewhere else
+#if defined(_MSC_VER)
+#define YRMU_NOINLINE __declspec(noinline)
+#else
+#define YRMU_NOINLINE __attribute__((noinline))
+#endif
+
+/**
+ * Count an allocation and make it, aligned to at least 'align' bytes. Over-aligned
+ * blocks keep the pointer malloc returned just before the block, so every form of
+ * delete can free what any form of new made.
+ *
+ * @param size bytes to allocate.
+ * @param align alignment, a power of two.
+ * @return the block, nullptr if it couldn't be allocated.
+ */
+YRMU_NOINLINE static void* counted_alloc(size_t size, size_t align) noexcept {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (align <= alignof(std::max_align_t))
+		return std::malloc(size ? size : 1);
+	void* raw = std::malloc(size + align + sizeof(void*));
+	if (raw == nullptr)
+		return nullptr;
+	uintptr_t p = (uintptr_t(raw) + sizeof(void*) + align - 1) & ~uintptr_t(align - 1);
+	((void**)p)[-1] = raw;
+	return (void*)p;
+}
+
+YRMU_NOINLINE static void counted_free(void* p, size_t align) noexcept {
+	if (p != nullptr && align > alignof(std::max_align_t))
+		p = ((void**)p)[-1];
+	std::free(p);
+}
+
+static void* counted_new(size_t size, size_t align) {
+	if (void* p = counted_alloc(size, align))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size) { return counted_new(size, 0); }
+void* operator new[](size_t size) { return counted_new(size, 0); }
+void* operator new(size_t size, std::align_val_t align) { return counted_new(size, size_t(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return counted_new(size, size_t(align)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return counted_alloc(size, size_t(align)); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return counted_alloc(size, size_t(align)); }
+
+void operator delete(void* p) noexcept { counted_free(p, 0); }
+void operator delete[](void* p) noexcept { counted_free(p, 0); }
+void operator delete(void* p, size_t) noexcept { counted_free(p, 0); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p, 0); }
+void operator delete(void* p, std::align_val_t align) noexcept { counted_free(p, size_t(align)); }
+void operator delete[](void* p, std::align_val_t align) noexcept { counted_free(p, size_t(align)); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { counted_free(p, size_t(align)); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { counted_free(p, size_t(align)); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p, 0); }
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept { counted_free(p, size_t(align)); }
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept { counted_free(p, size_t(align)); }
+
+/**
+ * Time spent and allocations made in one stage.
+ */
+struct Stage {
+	double ms = 0;
+	uint64_t allocations = 0;
+};
+
+/**
+ * Every stage of one run.
+ */
+struct StageTimes {
+	Stage scan;          // walking the tree into the inventory
+	Stage versionconfig; // reading versionconfig.ini and diffing it against the inventory
+	Stage read;          // reading maps
+	Stage previews;      // reading preview sizes
+	Stage naming;        // finding and sorting names
+	Stage build;         // building MPMaps.ini in memory
+	Stage write;         // writing MPMaps.ini out
+};
+
+/**
+ * Stopwatch which gives the time and allocations since it was last reset.
+ */
+class Stopwatch {
+public:
+	Stage lap() {
+		auto now = std::chrono::steady_clock::now();
+		uint64_t count = allocations.load(std::memory_order_relaxed);
+		Stage stage{ std::chrono::duration<double, std::milli>(now - last).count(), count - lastAllocations };
+		last = now;
+		lastAllocations = count;
+		return stage;
+	}
+
+private:
+	std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+	uint64_t lastAllocations = allocations.load(std::memory_order_relaxed);
+};
+
+/**
+ * Everything that comes out of one run of the pipeline.
+ */
+struct RunResult {
+	std::string mpmaps; // the whole MPMaps.ini
+	StageTimes times;
+	MapSet maps;
+	FileInventory inventory;
+	VersionDiff diff;
+};
+
+/**
+ * Run every stage of the tool on a tree, the same way YRMapsUpdater.cpp does.
+ *
+ * @param pool threads to run on.
+ * @param cncnet root of the tree.
+ * @param base MPMapsBase.ini.
+ * @param out where to write MPMaps.ini.
+ * @param cache data from the last run, empty to read every map.
+ * @param snapshot snapshot to take the maps from instead of the tree, nullptr to read the tree.
+ * @return the output and how long each stage took.
+ */
+RunResult run(ThreadPool& pool, const fs::path& cncnet, const fs::path& base, const fs::path& out,
+		const MapCache& cache, const SnapshotReader* snapshot = nullptr) {
+	RunResult r;
+	Stopwatch sw;
+	const IniDocument mpmapsOld(cncnet / "INI" / "MPMaps.ini");
+	r.inventory.scan(cncnet, cncnet / "Maps" / "Yuri's Revenge");
+	r.times.scan = sw.lap();
+
+	std::vector<VersionEntry> versionEntries = read_versionconfig(cncnet / "versionconfig.ini", "Maps\\Yuri's Revenge");
+	std::vector<VersionEntry> treeEntries(r.inventory.size());
+	for (size_t i = 0; i < r.inventory.size(); ++i) {
+		treeEntries[i].path = r.inventory.path(i);
+		std::replace(treeEntries[i].path.begin(), treeEntries[i].path.end(), '/', '\\');
+		treeEntries[i].size = versionconfig_size(r.inventory.file(i).stamp.size);
+	}
+	r.diff = diff_versionconfig(versionEntries, treeEntries);
+	r.times.versionconfig = sw.lap();
+
+	SharedMaps shared;
+	r.maps = snapshot ? snapshot_maps(*snapshot) : read_maps(pool, r.inventory, cncnet, cache, shared);
+	r.times.read = sw.lap();
+	read_previews(pool, r.maps, cncnet);
+	r.times.previews = sw.lap();
+
+	MapNames names = name_maps(pool, r.maps, mpmapsOld);
+	r.times.naming = sw.lap();
+
+	IniWriter mpmaps;
+	mpmaps.load(base);
+	build_mpmaps(mpmaps, pool, r.maps, names, mpmapsOld);
+	r.times.build = sw.lap();
+
+	mpmaps.save(out);
+	r.times.write = sw.lap();
+	r.mpmaps = mpmaps.str();
+	return r;
+}
+
+/**
+ * Compare everything read from two maps, leaving out their previews.
+ *
+ * @param a data of one map.
+ * @param b data of the other.
+ * @return true if the maps read the same, false if not.
+ */
+bool same_map_data(const MapData& a, const MapData& b) {
+	auto aStrings = map_data_strings(a), bStrings = map_data_strings(b);
+	for (size_t i = 0; i < aStrings.size(); ++i)
+		if (*aStrings[i] != *bStrings[i])
+			return false;
+	return a.enemyHouses == b.enemyHouses && a.waypoints == b.waypoints && a.forcedOptions == b.forcedOptions
+		&& a.forcedSpawnIniOptions == b.forcedSpawnIniOptions;
+}
+
+/**
+ * Print usage and exit.
+ */
+[[noreturn]] void usage() {
+	std::cerr << "usage: pipeline_bench [--maps N] [--seed N] [--min-kb N] [--max-kb N] [--coop F] [--forced F]\n"
+		"                      [--jobs N] [--dir PATH] [--base PATH] [--golden FILE] [--write-golden FILE] [--keep]\n";
+	std::exit(2);
+}
+
+int main(int argc, const char** argv) {
+	SynthOptions opt;
+	size_t jobs = 0;
+	fs::path dir = fs::temp_directory_path() / "yrmu_bench";
+	fs::path base = fs::path(YRMU_SOURCE_DIR) / "MPMapsBase.ini";
+	fs::path goldenPath, writeGoldenPath;
+	bool keep = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		auto next = [&]() -> const char* {
+			if (i + 1 >= argc)
+				usage();
+			return argv[++i];
+		};
+		if (arg == "--maps")
+			opt.maps = std::strtoul(next(), nullptr, 10);
+		else if (arg == "--seed")
+			opt.seed = std::strtoull(next(), nullptr, 10);
+		else if (arg == "--min-kb")
+			opt.minKB = std::strtoul(next(), nullptr, 10);
+		else if (arg == "--max-kb")
+			opt.maxKB = std::strtoul(next(), nullptr, 10);
+		else if (arg == "--coop")
+			opt.coopShare = std::strtod(next(), nullptr);
+		else if (arg == "--forced")
+			opt.forcedShare = std::strtod(next(), nullptr);
+		else if (arg == "--jobs" || arg == "-j")
+			jobs = std::strtoul(next(), nullptr, 10);
+		else if (arg == "--dir")
+			dir = next();
+		else if (arg == "--base")
+			base = next();
+		else if (arg == "--golden")
+			goldenPath = next();
+		else if (arg == "--write-golden")
+			writeGoldenPath = next();
+		else if (arg == "--keep")
+			keep = true;
+		else
+			usage();
+	}
+
+	// only ever work in a directory the bench made, everything in it is replaced and deleted
+	const fs::path marker = dir / ".yrmu_bench";
+	std::error_code ec;
+	if (fs::exists(dir) && !fs::is_empty(dir, ec) && !fs::exists(marker)) {
+		std::cerr << dir.string() << " isn't empty and wasn't made by pipeline_bench, pass an empty or new directory with --dir" << std::endl;
+		return 2;
+	}
+	fs::create_directories(dir);
+	std::ofstream(marker).close();
+
+	fs::path cncnet = dir / "CnCNet";
+	Stopwatch sw;
+	uint64_t treeBytes = SynthTree(opt).generate(cncnet);
+	double generateMs = sw.lap().ms;
+
+	// the timed run, on every core with nothing cached
+	ThreadPool pool(jobs);
+	MapCache emptyCache;
+	RunResult main = run(pool, cncnet, base, dir / "MPMaps.ini", emptyCache);
+	uint64_t peakMemory = peak_memory(); // before the runs below can add to it
+
+	// the same tree has to give the same bytes every other way we can build it
+	ThreadPool single(1);
+	bool sameSingle = run(single, cncnet, base, dir / "MPMaps.1.ini", emptyCache).mpmaps == main.mpmaps;
+
+	MapCache cache;
+	cache_maps(cache, main.maps);
+	cache.save(dir / "MapCache.bin");
+	MapCache loaded;
+	loaded.load(dir / "MapCache.bin");
+	RunResult cached = run(pool, cncnet, base, dir / "MPMaps.cached.ini", loaded);
+	bool sameCached = cached.mpmaps == main.mpmaps && cached.maps.reused == main.maps.keys.size();
+
+	std::vector<const MapData*> mapData;
+	for (const MapCache::Entry& e : main.maps.entries)
+		mapData.push_back(&e.data);
+	std::vector<std::string> files;
+	for (size_t i = 0; i < main.inventory.size(); ++i)
+		files.emplace_back(main.inventory.path(i));
+	write_snapshot(dir / "snapshot.bin", main.maps.rootPrefix, main.maps.keys, mapData, files);
+	SnapshotReader snapshot;
+	std::string error;
+	bool sameSnapshot = snapshot.open(dir / "snapshot.bin", error)
+		&& run(pool, cncnet, base, dir / "MPMaps.snapshot.ini", emptyCache, &snapshot).mpmaps == main.mpmaps;
+
+	// what watching with --embedded-previews leaves in the cache, which an incremental run without it has to ignore
+	MapSet watched = main.maps;
+	read_embedded_previews(pool, watched, cncnet, EmbeddedPreviews::size);
+	MapCache watchedCache;
+	cache_maps(watchedCache, watched);
+	watchedCache.save(dir / "MapCache.watched.bin");
+	MapCache watchedLoaded;
+	watchedLoaded.load(dir / "MapCache.watched.bin");
+	bool sameWatched = run(pool, cncnet, base, dir / "MPMaps.watched.ini", watchedLoaded).mpmaps == main.mpmaps;
+
+	// sections are named relative to CnCNet, so a golden file holds for the same options wherever the tree is generated
+	std::string golden;
+	if (!goldenPath.empty()) {
+		std::ifstream in(goldenPath, std::ios::binary);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		golden = ss.str();
+	}
+	if (!writeGoldenPath.empty())
+		std::ofstream(writeGoldenPath, std::ios::binary) << main.mpmaps;
+	bool sameGolden = goldenPath.empty() || golden == main.mpmaps;
+
+	// regenerate most previews from the maps themselves, as if their PNGs were missing, and the PNGs written over
+	// have to come out the same size, while every third map looks like its PNG is there but unreadable and is left alone
+	MapSet regenerated = main.maps;
+	size_t unreadable = 0;
+	for (size_t i = 0; i < regenerated.entries.size(); ++i) {
+		MapCache::Entry& e = regenerated.entries[i];
+		e.data.hasPreview = false;
+		if (i % 3 == 0 && e.preview != FileStamp())
+			++unreadable;
+		else
+			e.preview = FileStamp();
+	}
+	sw.lap();
+	size_t extracted = read_embedded_previews(pool, regenerated, cncnet, EmbeddedPreviews::extract);
+	double extractMs = sw.lap().ms;
+	bool samePreviews = extracted == regenerated.keys.size() - unreadable;
+	for (size_t i = 0; i < main.maps.entries.size(); ++i)
+		if (main.maps.entries[i].data.hasPreview && main.maps.entries[i].data.previewSize != regenerated.entries[i].data.previewSize)
+			samePreviews = false;
+
+	// what --patch-old does to the tree's old MPMaps.ini, which has to read back the same as the new one
+	const IniDocument mpmapsOld(cncnet / "INI" / "MPMaps.ini");
+	const IniDocument mpmapsNew(std::vector<char>(main.mpmaps.begin(), main.mpmaps.end()));
+	sw.lap();
+	IniDiff mpmapsDiff = diff_ini(mpmapsOld, mpmapsNew);
+	IniWriter patched;
+	patched.load(cncnet / "INI" / "MPMaps.ini");
+	patch_ini(patched, mpmapsDiff);
+	std::string patchedText = patched.str();
+	double patchMs = sw.lap().ms;
+	bool samePatched = diff_ini(IniDocument(std::vector<char>(patchedText.begin(), patchedText.end())), mpmapsNew).empty();
+
+	// the scanner skips most of every map, what it reads has to be what parsing the whole map gives
+	std::atomic<size_t> misread{ 0 };
+	pool.parallel_for(main.maps.entries.size(), [&](size_t i, size_t) {
+		MapData parsed = map_data_from_ini(IniDocument(fs::path(main.maps.rootPrefix + main.maps.keys[i])));
+		if (!same_map_data(parsed, main.maps.entries[i].data))
+			misread.fetch_add(1, std::memory_order_relaxed);
+	});
+	bool sameParsed = misread == 0;
+
+	// copies are read once and reported, variants only share their size with the map they were made from and stay apart
+	size_t copies = 0, copiesReported = 0;
+	bool variantsApart = true;
+	for (const std::string& key : main.maps.keys)
+		copies += key.find("copy_of_") != std::string::npos;
+	for (const std::vector<size_t>& group : duplicate_maps(main.maps)) {
+		copiesReported += group.size() - 1;
+		for (size_t i : group)
+			if (main.maps.keys[i].find("variant_of_") != std::string::npos)
+				variantsApart = false;
+	}
+	bool sameDuplicates = copiesReported == copies && main.maps.shared == copies && variantsApart;
+
+	const StageTimes& t = main.times;
+	Stage total;
+	for (const Stage* s : { &t.scan, &t.versionconfig, &t.read, &t.previews, &t.naming, &t.build, &t.write }) {
+		total.ms += s->ms;
+		total.allocations += s->allocations;
+	}
+	auto stages = [&](auto field) {
+		std::ostringstream out;
+		out << "{\n"
+			<< "    \"scan\": " << field(t.scan) << ",\n"
+			<< "    \"versionconfig\": " << field(t.versionconfig) << ",\n"
+			<< "    \"read\": " << field(t.read) << ",\n"
+			<< "    \"previews\": " << field(t.previews) << ",\n"
+			<< "    \"naming\": " << field(t.naming) << ",\n"
+			<< "    \"build\": " << field(t.build) << ",\n"
+			<< "    \"write\": " << field(t.write) << ",\n"
+			<< "    \"total\": " << field(total) << "\n"
+			<< "  }";
+		return out.str();
+	};
+	std::cout << std::boolalpha << "{\n"
+		<< "  \"maps\": " << main.maps.keys.size() << ",\n"
+		<< "  \"files\": " << main.inventory.size() << ",\n"
+		<< "  \"seed\": " << opt.seed << ",\n"
+		<< "  \"jobs\": " << pool.size() << ",\n"
+		<< "  \"tree_bytes\": " << treeBytes << ",\n"
+		<< "  \"generate_ms\": " << generateMs << ",\n"
+		<< "  \"stages_ms\": " << stages([](const Stage& s) { return s.ms; }) << ",\n"
+		<< "  \"allocations\": " << stages([](const Stage& s) { return s.allocations; }) << ",\n"
+		<< "  \"peak_memory_bytes\": " << peakMemory << ",\n"
+		<< "  \"cached_read_ms\": " << cached.times.read.ms << ",\n"
+		<< "  \"extract_previews_ms\": " << extractMs << ",\n"
+		<< "  \"patch_old\": { \"ms\": " << patchMs << ", \"added\": " << mpmapsDiff.added.size() << ", \"removed\": "
+		<< mpmapsDiff.removed.size() << ", \"changed\": " << mpmapsDiff.changed.size() << ", \"unchanged\": " << mpmapsDiff.unchanged << " },\n"
+		<< "  \"bytes\": { \"total\": " << main.maps.stats.bytesTotal << ", \"looked_at\": " << main.maps.stats.bytesRead
+		<< ", \"parsed\": " << main.maps.stats.bytesParsed << ", \"hashed\": " << main.maps.stats.bytesHashed << " },\n"
+		<< "  \"duplicates\": { \"copies\": " << copies << ", \"reported\": " << copiesReported << ", \"shared\": " << main.maps.shared
+		<< ", \"variants_apart\": " << variantsApart << " },\n"
+		<< "  \"versionconfig\": { \"missing\": " << main.diff.missing.size() << ", \"stale\": " << main.diff.stale.size()
+		<< ", \"orphaned\": " << main.diff.orphaned.size() << ", \"current\": " << main.diff.current << " },\n"
+		<< "  \"mpmaps_bytes\": " << main.mpmaps.size() << ",\n"
+		<< "  \"identical\": { \"full_parse\": " << sameParsed << ", \"single_thread\": " << sameSingle << ", \"cache\": " << sameCached
+		<< ", \"snapshot\": " << sameSnapshot << ", \"embedded_previews\": " << samePreviews
+		<< ", \"embedded_not_cached\": " << sameWatched << ", \"patch_old\": " << samePatched
+		<< ", \"golden\": " << (goldenPath.empty() ? "null" : (sameGolden ? "true" : "false")) << " }\n"
+		<< "}" << std::endl;
+
+	if (!keep) {
+		// just what the bench wrote, and the directory itself once that leaves it empty
+		for (const char* name : { "CnCNet", "MPMaps.ini", "MPMaps.1.ini", "MPMaps.cached.ini", "MPMaps.snapshot.ini", "MPMaps.watched.ini",
+				"MapCache.bin", "MapCache.watched.bin", "snapshot.bin", ".yrmu_bench" })
+			fs::remove_all(dir / name, ec);
+		fs::remove(dir, ec);
+	}
+	return (sameParsed && sameDuplicates && sameSingle && sameCached && sameSnapshot && samePreviews && sameWatched && samePatched && sameGolden) ? 0 : 1;
+}
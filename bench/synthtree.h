@@ -0,0 +1,428 @@
+/**
+ * @file synthtree.h
+ * @brief Generator for synthetic CnCNet map trees to benchmark against.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * What the generated tree looks like. Everything is derived from the seed,
+ * so the same options always give the same tree, byte for byte.
+ */
+struct SynthOptions {
+	size_t maps = 2000;
+	uint64_t seed = 1;
+	size_t minKB = 20;         // map sizes are spread log-uniformly between these
+	size_t maxKB = 600;
+	size_t directories = 12;   // subdirectories of Maps/Yuri's Revenge the maps are spread over
+	double coopShare = 0.1;    // maps which are coop missions
+	double forcedShare = 0.2;  // maps with [ForcedOptions] and [ForcedSpawnIniOptions]
+	double previewShare = 0.9; // maps with a PNG preview
+	double unnamedShare = 0.03; // maps whose name is only in the old MPMaps.ini
+	double listedShare = 0.85; // maps and previews already in versionconfig.ini
+	size_t copyEvery = 50;     // one map in so many is copied to another directory, and another gets a variant of the same size
+};
+
+/**
+ * Writes a synthetic CnCNet directory: Maps/Yuri's Revenge full of maps and
+ * previews, INI/MPMaps.ini describing some of them and versionconfig.ini
+ * listing most of them.
+ */
+class SynthTree {
+public:
+	explicit SynthTree(const SynthOptions& options) : opt(options), rng(options.seed) {}
+
+	/**
+	 * Generate the tree, replacing anything already at 'root'.
+	 *
+	 * @param root directory to use as CnCNet.
+	 * @return total bytes written.
+	 */
+	uint64_t generate(const std::filesystem::path& root) {
+		namespace fs = std::filesystem;
+		fs::remove_all(root);
+		fs::path mapsDir = root / "Maps" / "Yuri's Revenge";
+		fs::create_directories(root / "INI");
+		std::vector<std::string> dirs;
+		for (size_t d = 0; d < opt.directories; ++d) {
+			dirs.push_back((d == 0) ? std::string() : pick(dirWords) + std::to_string(d));
+			fs::create_directories(mapsDir / dirs.back());
+		}
+
+		uint64_t bytes = 0;
+		std::string mpmapsOld, versionconfig = "[FileVersions]\r\n";
+		for (size_t m = 0; m < opt.maps; ++m) {
+			std::string dir = dirs[m % dirs.size()];
+			std::string name = pick(nameWords) + '_' + std::to_string(m);
+			std::string rel = dir.empty() ? name : dir + '\\' + name;
+			fs::path mapPath = mapsDir / dir / (name + ".map");
+			Map map = make_map(m);
+
+			std::string content = map_content(map);
+			bytes += write(mapPath, content);
+			// copies and variants are left out of versionconfig.ini and the old MPMaps.ini, so the rest of the tree
+			// is the same with or without them
+			if (opt.copyEvery > 0 && m % opt.copyEvery == opt.copyEvery / 2)
+				bytes += write(mapsDir / dirs[(m + 1) % dirs.size()] / ("copy_of_" + name + ".map"), content);
+			if (opt.copyEvery > 0 && m % opt.copyEvery == opt.copyEvery - 1)
+				bytes += write(mapsDir / dirs[(m + 1) % dirs.size()] / ("variant_of_" + name + ".map"), variant(content));
+			std::string section = "Maps\\Yuri's Revenge\\" + rel;
+			add_version(versionconfig, section + ".map", content.size());
+			if (chance(opt.previewShare)) {
+				std::string png = png_content(map.previewWidth, map.previewHeight);
+				bytes += write(fs::path(mapPath).replace_extension(".png"), png);
+				add_version(versionconfig, section + ".png", png.size());
+			}
+
+			// the old MPMaps.ini knows most maps, and is the only place some of them are named
+			if (!map.nameInMap || chance(0.6)) {
+				mpmapsOld += "[" + section + "]\r\n";
+				if (!map.nameInMap || chance(0.5))
+					mpmapsOld += "Description=" + map.title + "\r\n";
+				if (chance(0.7))
+					mpmapsOld += "Author=" + pick(authors) + "\r\n";
+				if (chance(0.3))
+					mpmapsOld += "GameModes=" + pick(gameModes) + "\r\n";
+				if (map.coop && chance(0.5))
+					mpmapsOld += "IsCoopMission=yes\r\nEnemyHouse0=" + std::to_string(uniform(0, 9)) + ",3,"
+						+ std::to_string(map.waypoints - 1) + "\r\n";
+				mpmapsOld += "\r\n";
+			}
+		}
+		for (size_t o = 0; o < opt.maps / 50; ++o) // entries for maps which were deleted since
+			versionconfig += "Maps\\Yuri's Revenge\\deleted_" + std::to_string(o) + ".map=" + hex(40) + ",12\r\n";
+		bytes += write(root / "INI" / "MPMaps.ini", mpmapsOld);
+		bytes += write(root / "versionconfig.ini", versionconfig);
+		return bytes;
+	}
+
+private:
+	struct Map {
+		std::string title;
+		bool nameInMap;
+		bool coop;
+		bool forced;
+		int forcedAt; // 0 after [Waypoints], 1 between the body and [Waypoints], 2 between two packs of the body
+		int players;
+		int waypoints;
+		size_t targetSize;
+		int previewWidth, previewHeight;
+	};
+
+	Map make_map(size_t m) {
+		Map map;
+		map.players = uniform(2, 8);
+		map.title = "[" + std::to_string(map.players) + "] " + pick(titleWords) + ' ' + pick(titleWords);
+		if (m % 97 == 0)
+			map.title = "[4] Duplicate Name"; // same title in several directories
+		map.nameInMap = !chance(opt.unnamedShare);
+		map.coop = chance(opt.coopShare);
+		map.forced = chance(opt.forcedShare);
+		map.forcedAt = int(m % 3);
+		map.waypoints = map.players + (map.coop ? uniform(1, 3) : 0);
+		double lo = std::log(double(opt.minKB)), hi = std::log(double(std::max(opt.maxKB, opt.minKB)));
+		map.targetSize = size_t(std::exp(lo + (hi - lo) * real()) * 1024);
+		map.previewWidth = uniform(100, 400);
+		map.previewHeight = uniform(80, 300);
+		return map;
+	}
+
+	/**
+	 * Write the map the way FinalAlert 2 lays them out: the preview first, the
+	 * sections we read spread between base64 packs and other sections. Forced
+	 * options, which are added by hand, end up wherever they were pasted.
+	 */
+	std::string map_content(const Map& map) {
+		std::string basic = "[Basic]\r\n";
+		if (map.nameInMap)
+			basic += "Name=" + map.title + "\r\n";
+		if (chance(0.8))
+			basic += "Author=" + pick(authors) + "\r\n";
+		basic += "Briefing=" + std::string(chance(0.1) ? "Brief:ALL0" + std::to_string(uniform(1, 9)) : pick(briefings)) + "\r\n";
+		basic += "GameMode=" + pick(gameModes) + "\r\nPercent=0\r\nMultiplayerOnly=1\r\n";
+		if (map.coop) {
+			basic += "IsCoopMission=yes\r\nDisallowedPlayerSides=" + std::to_string(uniform(0, 9)) + "\r\n";
+			for (int e = 0, enemies = map.waypoints - map.players; e < enemies; ++e)
+				basic += "EnemyHouse" + std::to_string(e) + '=' + std::to_string(uniform(0, 9)) + ',' + std::to_string(uniform(0, 7))
+					+ ',' + std::to_string(map.players + e) + (chance(0.5) ? " ;enemy base\r\n" : "\r\n");
+		}
+
+		int w = uniform(50, 150), h = uniform(50, 150);
+		std::string mapSection = "[Map]\r\nSize=0,0," + std::to_string(w) + ',' + std::to_string(h) + "\r\nTheater=TEMPERATE\r\nLocalSize=2,4,"
+			+ std::to_string(w - 4) + ',' + std::to_string(h - 10) + "\r\n";
+		std::string waypoints = "[Waypoints]\r\n";
+		for (int n = 0; n < map.waypoints; ++n)
+			waypoints += std::to_string(n) + '=' + std::to_string(uniform(10000, 150150)) + "\r\n";
+		for (int n = 90; n < 98; ++n)
+			waypoints += std::to_string(n) + '=' + std::to_string(uniform(10000, 150150)) + "\r\n";
+		std::string forced;
+		if (map.forced)
+			forced = "[ForcedOptions]\r\nChkShortGame=False\r\nChkSuperWeapons=" + std::string(chance(0.5) ? "False" : "True")
+				+ "\r\n\r\n[ForcedSpawnIniOptions]\r\nGameSpeed=" + std::to_string(uniform(0, 6)) + "\r\n";
+
+		// the rest of the size goes to base64 packs and filler sections
+		size_t small = basic.size() + mapSection.size() + waypoints.size() + forced.size();
+		size_t packs = (map.targetSize > small + 2048) ? map.targetSize - small - 2048 : 1024;
+		std::string out;
+		out += "[Preview]\r\nSize=0,0," + std::to_string(map.previewWidth) + ',' + std::to_string(map.previewHeight) + "\r\n\r\n";
+		out += preview_pack(map.previewWidth, map.previewHeight) + "\r\n";
+		out += "[Header]\r\nNumberStartingPoints=" + std::to_string(map.players) + "\r\nWidth=" + std::to_string(w) + "\r\n\r\n";
+		out += basic + "\r\n";
+		out += mapSection + "\r\n";
+		out += pack("IsoMapPack5", packs / 2) + "\r\n";
+		if (!forced.empty() && map.forcedAt == 2)
+			out += forced + "\r\n";
+		out += pack("OverlayPack", packs / 10) + "\r\n";
+		out += pack("OverlayDataPack", packs / 10) + "\r\n";
+		if (!forced.empty() && map.forcedAt == 1)
+			out += forced + "\r\n";
+		out += filler("Structures", 40) + filler("Units", 40) + filler("Triggers", 60) + filler("Events", 60);
+		out += waypoints + "\r\n";
+		if (!forced.empty() && map.forcedAt == 0)
+			out += forced + "\r\n";
+		out += filler("Tags", 40) + pack("Digest", 40);
+		return out;
+	}
+
+	/**
+	 * Change a map without changing its size, by bumping the first digit of
+	 * waypoint 0, so it reads differently from the map it was made from.
+	 */
+	static std::string variant(std::string content) {
+		size_t at = content.find("[Waypoints]\r\n0=");
+		if (at != std::string::npos) {
+			char& digit = content[at + 15];
+			digit = char('0' + (digit - '0' + 1) % 10);
+		}
+		return content;
+	}
+
+	std::string pack(const char* name, size_t bytes) {
+		static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string out = std::string("[") + name + "]\r\n";
+		for (size_t line = 1; bytes > 0; ++line) {
+			size_t n = std::min<size_t>(bytes, 70);
+			out += std::to_string(line) + '=';
+			for (size_t i = 0; i < n; ++i)
+				out += alphabet[rng() & 63];
+			out += "\r\n";
+			bytes -= n;
+		}
+		return out;
+	}
+
+	/**
+	 * Draw a preview and pack it the way the game does: base64 of blocks of up
+	 * to 8 KB, each LZO1X compressed behind its packed and unpacked sizes.
+	 */
+	std::string preview_pack(int width, int height) {
+		// patches of colour, with most rows the same as the one above, like terrain seen from above
+		size_t rowSize = size_t(width) * 3;
+		std::vector<uint8_t> pixels(rowSize * size_t(height));
+		for (size_t y = 0; y < size_t(height); ++y) {
+			uint8_t* row = pixels.data() + y * rowSize;
+			if (y > 0 && chance(0.6)) {
+				std::copy(row - rowSize, row, row);
+				continue;
+			}
+			for (size_t x = 0; x < size_t(width); ) {
+				size_t run = std::min<size_t>(size_t(uniform(1, 40)), size_t(width) - x);
+				uint8_t rgb[3] = { uint8_t(rng()), uint8_t(rng()), uint8_t(rng()) };
+				for (size_t end = x + run; x < end; ++x)
+					std::copy(rgb, rgb + 3, row + x * 3);
+			}
+		}
+		std::string packed;
+		for (size_t at = 0; at < pixels.size(); at += 8192) {
+			size_t n = std::min<size_t>(pixels.size() - at, 8192);
+			std::string block = lzo1x_compress(pixels.data() + at, n, rowSize);
+			packed += char(block.size() & 0xFF);
+			packed += char(block.size() >> 8);
+			packed += char(n & 0xFF);
+			packed += char(n >> 8);
+			packed += block;
+		}
+
+		static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string text;
+		for (size_t i = 0; i < packed.size(); i += 3) {
+			uint32_t bits = uint32_t(uint8_t(packed[i])) << 16;
+			if (i + 1 < packed.size())
+				bits |= uint32_t(uint8_t(packed[i + 1])) << 8;
+			if (i + 2 < packed.size())
+				bits |= uint8_t(packed[i + 2]);
+			for (size_t k = 0; k < 4; ++k)
+				text += (i + k <= packed.size()) ? alphabet[(bits >> (18 - 6 * k)) & 63] : '=';
+		}
+		std::string out = "[PreviewPack]\r\n";
+		for (size_t line = 1, at = 0; at < text.size(); ++line, at += 70)
+			out += std::to_string(line) + '=' + text.substr(at, 70) + "\r\n";
+		return out;
+	}
+
+	/**
+	 * Compress with a subset of LZO1X: runs of literals, and matches against the
+	 * pixel to the left or the row above. Any LZO1X decoder reads it.
+	 */
+	static std::string lzo1x_compress(const uint8_t* in, size_t n, size_t rowSize) {
+		std::string out;
+		size_t literalsFrom = 0;
+		size_t lastMatch = std::string::npos; // byte of the last match which holds how many literals follow it
+		// a length which doesn't fit its instruction goes on in zero bytes worth 255 each
+		auto extended = [&](size_t rest) {
+			for (; rest > 255; rest -= 255)
+				out += '\0';
+			out += char(rest);
+		};
+		auto literals = [&](size_t to) {
+			size_t len = to - literalsFrom;
+			if (len == 0)
+				return;
+			if (out.empty() && len <= 238)
+				out += char(17 + len);
+			else if (lastMatch != std::string::npos && len <= 3)
+				out[lastMatch] = char(out[lastMatch] | len);
+			else if (len - 3 <= 15)
+				out += char(len - 3);
+			else {
+				out += '\0';
+				extended(len - 18);
+			}
+			out.append((const char*)in + literalsFrom, len);
+		};
+		for (size_t i = 0; i < n; ) {
+			size_t bestLen = 0, bestDistance = 0;
+			for (size_t distance : { size_t(3), rowSize }) {
+				if (distance > i || distance > 0x4000)
+					continue;
+				size_t len = 0;
+				while (i + len < n && in[i + len] == in[i + len - distance])
+					++len;
+				if (len > bestLen) {
+					bestLen = len;
+					bestDistance = distance;
+				}
+			}
+			if (bestLen < 4) {
+				++i;
+				continue;
+			}
+			literals(i);
+			if (bestLen - 2 <= 31)
+				out += char(32 | (bestLen - 2));
+			else {
+				out += char(32);
+				extended(bestLen - 2 - 31);
+			}
+			out += char(((bestDistance - 1) & 63) << 2);
+			out += char((bestDistance - 1) >> 6);
+			lastMatch = out.size() - 2;
+			i += bestLen;
+			literalsFrom = i;
+		}
+		literals(n);
+		out += std::string("\x11\0\0", 3); // end of stream
+		return out;
+	}
+
+	std::string filler(const char* name, size_t lines) {
+		std::string out = std::string("[") + name + "]\r\n";
+		for (size_t i = 0; i < lines; ++i)
+			out += std::to_string(i) + "=Americans,HTNK," + std::to_string(uniform(1, 256)) + ',' + std::to_string(uniform(10, 150))
+				+ ',' + std::to_string(uniform(10, 150)) + ",64,Guard,None,-1,-1,0,-1,0,1\r\n";
+		return out + "\r\n";
+	}
+
+	std::string png_content(int width, int height) {
+		std::string out("\x89PNG\r\n\x1A\n", 8);
+		std::string ihdr;
+		put_be32(ihdr, uint32_t(width));
+		put_be32(ihdr, uint32_t(height));
+		ihdr += std::string("\x08\x02\x00\x00\x00", 5);
+		chunk(out, "IHDR", ihdr);
+		std::string idat;
+		for (size_t i = 0, n = size_t(width) * size_t(height) / 4; i < n; ++i)
+			idat += char(rng() & 0xFF); // stands in for compressed image data, nothing decodes it
+		chunk(out, "IDAT", idat);
+		chunk(out, "IEND", "");
+		return out;
+	}
+
+	static void put_be32(std::string& out, uint32_t x) {
+		for (int s = 24; s >= 0; s -= 8)
+			out += char((x >> s) & 0xFF);
+	}
+
+	static void chunk(std::string& out, const char* type, const std::string& data) {
+		put_be32(out, uint32_t(data.size()));
+		std::string body = std::string(type) + data;
+		out += body;
+		uint32_t crc = 0xFFFFFFFF;
+		for (unsigned char c : body) {
+			crc ^= c;
+			for (int k = 0; k < 8; ++k)
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+		}
+		put_be32(out, ~crc);
+	}
+
+	void add_version(std::string& versionconfig, const std::string& path, size_t size) {
+		if (!chance(opt.listedShare))
+			return;
+		// a few entries are out of date
+		size_t kb = (size + 1023) / 1024 + (chance(0.05) ? 1 : 0);
+		versionconfig += path + '=' + hex(40) + ',' + std::to_string(kb) + "\r\n";
+	}
+
+	std::string hex(size_t digits) {
+		std::string out;
+		for (size_t i = 0; i < digits; ++i)
+			out += "0123456789ABCDEF"[rng() & 15];
+		return out;
+	}
+
+	static uint64_t write(const std::filesystem::path& path, const std::string& content) {
+		std::ofstream(path, std::ios::binary).write(content.data(), content.size());
+		return content.size();
+	}
+
+	int uniform(int lo, int hi) {
+		return lo + int(rng() % uint64_t(hi - lo + 1));
+	}
+
+	double real() {
+		return double(rng() >> 11) / double(1ull << 53);
+	}
+
+	bool chance(double p) {
+		return real() < p;
+	}
+
+	const std::string& pick(const std::vector<std::string>& words) {
+		return words[rng() % words.size()];
+	}
+
+	SynthOptions opt;
+	std::mt19937_64 rng;
+
+	const std::vector<std::string> titleWords = { "Dry", "Heat", "Little", "Big", "Lake", "Golden", "State", "Freeway",
+		"Ice", "Age", "Oasis", "Pinch", "Point", "Dustbowl", "Malibu", "Cliffs", "Isle", "War", "Cold", "Front", "Sinkhole",
+		"Canyon", "Fever", "Tour", "Egypt", "Streets", "Gold", "Loop", "Hole", "Near", "Ore", "Far", "Blitz", "Storm" };
+	const std::vector<std::string> nameWords = { "yr", "cnc", "dry", "lake", "canyon", "storm", "blitz", "ice", "oasis", "ridge" };
+	const std::vector<std::string> dirWords = { "Custom", "Coop", "Tournament", "Classic", "Community", "Special" };
+	const std::vector<std::string> authors = { "Westwood", "Kerbiter", "Holy", "Lgwaa", "Ravage", "Marko", "Chrono Vortex" };
+	const std::vector<std::string> gameModes = { "standard", "Standard", "Meat Grinder", "standard,Megawealth", "Free For All",
+		"Cooperative", "Land Rush" };
+	const std::vector<std::string> briefings = { "Destroy all enemy forces.", "Hold the bridge until reinforcements arrive.",
+		"Capture the tech buildings@@and defend them.", "" };
+};
@@ -0,0 +1,173 @@
+/**
+ * @file inidiff.h
+ * @brief Working out which sections and keys differ between two INI files, and patching one into the other.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "inidocument.h"
+#include "iniwriter.h"
+
+/**
+ * A key whose value differs between the two files.
+ */
+struct IniKeyChange {
+	std::string_view key;
+	std::string_view oldValue;
+	std::string_view newValue;
+};
+
+/**
+ * Keys which differ in a section found in both files.
+ */
+struct IniSectionDiff {
+	std::string_view name;
+	std::vector<IniDocument::Entry> added;   // only in the new file
+	std::vector<IniDocument::Entry> removed; // only in the old file
+	std::vector<IniKeyChange> modified;      // in both, with different values
+};
+
+/**
+ * Everything which differs between two INI files, as the PrivateProfile
+ * functions would read them. Names and values point into the two documents,
+ * so the diff is only valid as long as they are.
+ */
+struct IniDiff {
+	std::vector<const IniDocument::Section*> added;   // sections only in the new file
+	std::vector<const IniDocument::Section*> removed; // sections only in the old file
+	std::vector<IniSectionDiff> changed;              // sections in both, with keys which differ
+	size_t unchanged = 0;                             // sections in both, with the same keys and values
+
+	bool empty() const {
+		return added.empty() && removed.empty() && changed.empty();
+	}
+};
+
+/**
+ * Compare two INI files section by section and key by key. Names are compared
+ * ignoring case and values exactly, and only the first of a repeated section
+ * or key counts, so comments, blank lines, order and repeats don't show up.
+ *
+ * @param oldIni the file as it is.
+ * @param newIni the file as it should be.
+ * @return sections added, removed and changed, in the order of the file they're in.
+ */
+inline IniDiff diff_ini(const IniDocument& oldIni, const IniDocument& newIni) {
+	using NameSet = std::unordered_set<std::string_view, IniNameHash, IniNameEqual>;
+	IniDiff diff;
+	for (const IniDocument::Section& s : newIni.all_sections()) {
+		const IniDocument::Section* old = oldIni.section(s.name);
+		if (old == nullptr) {
+			diff.added.push_back(&s);
+			continue;
+		}
+		std::unordered_map<std::string_view, std::string_view, IniNameHash, IniNameEqual> oldKeys;
+		oldKeys.reserve(old->entries.size());
+		for (const IniDocument::Entry& e : old->entries)
+			oldKeys.emplace(e.key, e.value);
+		IniSectionDiff section{ s.name, {}, {}, {} };
+		NameSet seen; // keys already compared, so repeats are skipped
+		seen.reserve(s.entries.size());
+		for (const IniDocument::Entry& e : s.entries) {
+			if (!seen.insert(e.key).second)
+				continue;
+			auto found = oldKeys.find(e.key);
+			if (found == oldKeys.end())
+				section.added.push_back(e);
+			else if (found->second != e.value)
+				section.modified.push_back(IniKeyChange{ e.key, found->second, e.value });
+		}
+		for (const IniDocument::Entry& e : old->entries)
+			if (seen.insert(e.key).second)
+				section.removed.push_back(e); // the first of a repeated key, the one the old value came from
+		if (section.added.empty() && section.removed.empty() && section.modified.empty())
+			++diff.unchanged;
+		else
+			diff.changed.push_back(std::move(section));
+	}
+	for (const IniDocument::Section& s : oldIni.all_sections())
+		if (newIni.section(s.name) == nullptr)
+			diff.removed.push_back(&s);
+	return diff;
+}
+
+/**
+ * Write a value so it reads back the same, quoted if it would otherwise
+ * lose its surrounding whitespace or quotes.
+ *
+ * @param value value as it was read.
+ * @return value as it should be written.
+ */
+inline std::string ini_value(std::string_view value) {
+	bool quoted = value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0];
+	if (!quoted && str_trim(value).size() == value.size())
+		return std::string(value);
+	return '"' + std::string(value) + '"';
+}
+
+/**
+ * Write the differences the way a unified diff marks lines, '+' for what the
+ * new file adds, '-' for what it drops, and a changed key as one of each.
+ * Sections which are only changed get a header with no mark, and values are
+ * written the way a patch writes them.
+ *
+ * @param out stream to write to.
+ * @param diff differences to write.
+ */
+inline void write_ini_diff(std::ostream& out, const IniDiff& diff) {
+	out << "; " << diff.added.size() << " sections added, " << diff.removed.size() << " removed, "
+		<< diff.changed.size() << " changed and " << diff.unchanged << " unchanged" << std::endl;
+	for (const IniDocument::Section* s : diff.added) {
+		out << std::endl << "+[" << s->name << ']' << std::endl;
+		for (const IniDocument::Entry& e : s->entries)
+			out << '+' << e.key << '=' << ini_value(e.value) << std::endl;
+	}
+	for (const IniDocument::Section* s : diff.removed)
+		out << std::endl << "-[" << s->name << ']' << std::endl;
+	for (const IniSectionDiff& s : diff.changed) {
+		out << std::endl << " [" << s.name << ']' << std::endl;
+		for (const IniDocument::Entry& e : s.removed)
+			out << '-' << e.key << '=' << ini_value(e.value) << std::endl;
+		for (const IniKeyChange& c : s.modified) {
+			out << '-' << c.key << '=' << ini_value(c.oldValue) << std::endl;
+			out << '+' << c.key << '=' << ini_value(c.newValue) << std::endl;
+		}
+		for (const IniDocument::Entry& e : s.added)
+			out << '+' << e.key << '=' << ini_value(e.value) << std::endl;
+	}
+}
+
+/**
+ * Apply the differences to the old file, loaded into a writer. Lines which
+ * aren't changed stay byte for byte as they were, changed keys are rewritten
+ * in place, and added keys and sections go where the profile API puts them.
+ *
+ * @param ini the old file, loaded with IniWriter::load.
+ * @param diff differences from the old file to the new one.
+ */
+inline void patch_ini(IniWriter& ini, const IniDiff& diff) {
+	for (const IniSectionDiff& s : diff.changed) {
+		for (const IniKeyChange& c : s.modified)
+			ini.set(s.name, c.key, ini_value(c.newValue));
+		for (const IniDocument::Entry& e : s.added)
+			ini.set(s.name, e.key, ini_value(e.value));
+		for (const IniDocument::Entry& e : s.removed)
+			ini.remove(s.name, e.key);
+	}
+	for (const IniDocument::Section* s : diff.added) {
+		IniWriter::Entries entries;
+		entries.reserve(s->entries.size());
+		for (const IniDocument::Entry& e : s->entries)
+			entries.emplace_back(e.key, ini_value(e.value));
+		ini.set_section(s->name, entries);
+	}
+	for (const IniDocument::Section* s : diff.removed)
+		ini.remove_section(s->name);
+}
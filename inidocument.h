@@ -0,0 +1,233 @@
+/**
+ * @file inidocument.h
+ * @brief Read-only INI document which is parsed once and queried from memory.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Check if two strings are equal, ignoring case the
+ * same way the PrivateProfile functions do.
+ *
+ * @param a first string to compare.
+ * @param b second string to compare.
+ * @return true if 'a' and 'b' are equal ignoring case, false if not.
+ */
+inline bool str_iequals(std::string_view a, std::string_view b) {
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+		if (std::tolower((unsigned char)a[i]) != std::tolower((unsigned char)b[i]))
+			return false;
+	return true;
+}
+
+/**
+ * Remove whitespace from the beginning and end of a string.
+ *
+ * @param s string to trim.
+ * @return view of 's' without leading or trailing whitespace.
+ */
+inline std::string_view str_trim(std::string_view s) {
+	size_t first = 0, last = s.size();
+	while (first < last && std::isspace((unsigned char)s[first]))
+		++first;
+	while (last > first && std::isspace((unsigned char)s[last - 1]))
+		--last;
+	return s.substr(first, last - first);
+}
+
+/**
+ * Case-insensitive hash for section and key names.
+ */
+struct IniNameHash {
+	size_t operator()(std::string_view s) const {
+		uint64_t h = 14695981039346656037ull; // FNV-1a
+		for (char c : s)
+			h = (h ^ uint64_t(std::tolower((unsigned char)c))) * 1099511628211ull;
+		return size_t(h);
+	}
+};
+
+/**
+ * Case-insensitive equality for section and key names.
+ */
+struct IniNameEqual {
+	bool operator()(std::string_view a, std::string_view b) const {
+		return str_iequals(a, b);
+	}
+};
+
+/**
+ * INI file which is read and indexed once, every lookup after that is served
+ * from memory. Keys and values are views into the file buffer, so they stay
+ * valid for as long as the document does.
+ *
+ * Lookups follow the rules of GetPrivateProfileString: section and key names
+ * are case-insensitive, whitespace around keys and values is ignored, a pair
+ * of quotes around a value is removed, and the first match wins.
+ *
+ * Sections and keys are hashed, so a lookup costs the same no matter how big
+ * the file is. The document is never modified after it's loaded, so one
+ * instance can be shared by everything that reads it.
+ */
+class IniDocument {
+public:
+	struct Entry {
+		std::string_view key;
+		std::string_view value;
+	};
+
+	struct Section {
+		std::string_view name;
+		std::vector<Entry> entries;
+	};
+
+	IniDocument() = default;
+
+	/**
+	 * Read and index an INI file. A missing or unreadable
+	 * file results in an empty document.
+	 *
+	 * @param path path to the INI file to read.
+	 */
+	explicit IniDocument(const std::filesystem::path& path) {
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		if (!in)
+			return;
+		text.resize(size_t(in.tellg()));
+		in.seekg(0);
+		in.read(text.data(), text.size());
+		text.resize(size_t(in.gcount()));
+		parse();
+	}
+
+	/**
+	 * Index INI text which has already been read.
+	 *
+	 * @param buffer text of the INI file, the document takes ownership of it.
+	 */
+	explicit IniDocument(std::vector<char>&& buffer) : text(std::move(buffer)) {
+		parse();
+	}
+
+	// keys and values point into the buffer, so don't allow copies
+	IniDocument(const IniDocument&) = delete;
+	IniDocument& operator=(const IniDocument&) = delete;
+	IniDocument(IniDocument&&) = default;
+	IniDocument& operator=(IniDocument&&) = default;
+
+	/**
+	 * Get the size of the INI text.
+	 *
+	 * @return number of bytes read from the file.
+	 */
+	size_t size() const {
+		return text.size();
+	}
+
+	/**
+	 * Get every section, in the order they appear in the file.
+	 *
+	 * @return list of sections.
+	 */
+	const std::vector<Section>& all_sections() const {
+		return sections;
+	}
+
+	/**
+	 * Find a section by name.
+	 *
+	 * @param name name of the section to find.
+	 * @return pointer to the section, nullptr if it doesn't exist.
+	 */
+	const Section* section(std::string_view name) const {
+		auto found = sectionIndex.find(name);
+		return (found == sectionIndex.end()) ? nullptr : &sections[found->second];
+	}
+
+	/**
+	 * Get the value of a key, equivalent to GetPrivateProfileString.
+	 *
+	 * @param sectionName name of the section containing the key.
+	 * @param key name of the key to get the value of.
+	 * @param def value to return if the key doesn't exist.
+	 * @return value of the key, or 'def' if it doesn't exist.
+	 */
+	std::string_view get(std::string_view sectionName, std::string_view key, std::string_view def = {}) const {
+		auto foundSection = sectionIndex.find(sectionName);
+		if (foundSection == sectionIndex.end())
+			return def;
+		auto found = keyIndex.find(KeyRef{ foundSection->second, key });
+		return (found == keyIndex.end()) ? def : found->second;
+	}
+
+private:
+	struct KeyRef {
+		size_t section;
+		std::string_view key;
+	};
+
+	struct KeyRefHash {
+		size_t operator()(const KeyRef& k) const {
+			return IniNameHash()(k.key) ^ (k.section * 0x9E3779B97F4A7C15ull);
+		}
+	};
+
+	struct KeyRefEqual {
+		bool operator()(const KeyRef& a, const KeyRef& b) const {
+			return a.section == b.section && str_iequals(a.key, b.key);
+		}
+	};
+
+	/**
+	 * Split the buffer into sections and entries, then index them.
+	 */
+	void parse() {
+		std::string_view rest(text.data(), text.size());
+		Section* current = nullptr;
+		size_t currentIndex = 0;
+		while (!rest.empty()) {
+			size_t eol = rest.find('\n');
+			std::string_view line = str_trim(rest.substr(0, eol));
+			rest = (eol == std::string_view::npos) ? std::string_view() : rest.substr(eol + 1);
+
+			if (line.empty() || line[0] == ';')
+				continue;
+			if (line[0] == '[') {
+				size_t close = line.find(']');
+				std::string_view name = str_trim(line.substr(1, (close == std::string_view::npos) ? close : close - 1));
+				// a repeated section is ignored, lookups only ever see the first one
+				current = nullptr;
+				if (sectionIndex.emplace(name, sections.size()).second) {
+					currentIndex = sections.size();
+					current = &sections.emplace_back(Section{ name, {} });
+				}
+				continue;
+			}
+			size_t eq = line.find('=');
+			if (current == nullptr || eq == std::string_view::npos)
+				continue;
+			std::string_view value = str_trim(line.substr(eq + 1));
+			if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0])
+				value = value.substr(1, value.size() - 2);
+			std::string_view key = str_trim(line.substr(0, eq));
+			current->entries.push_back(Entry{ key, value });
+			keyIndex.emplace(KeyRef{ currentIndex, key }, value);
+		}
+	}
+
+	std::vector<char> text;
+	std::vector<Section> sections;
+	std::unordered_map<std::string_view, size_t, IniNameHash, IniNameEqual> sectionIndex;
+	std::unordered_map<KeyRef, std::string_view, KeyRefHash, KeyRefEqual> keyIndex;
+};
@@ -0,0 +1,309 @@
+/**
+ * @file iniwriter.h
+ * @brief In-memory INI output which is written to disk in one go.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "inidocument.h"
+
+/**
+ * Make a lowercase copy of a string, used to index
+ * sections and keys case-insensitively.
+ *
+ * @param s string to convert.
+ * @return lowercase copy of 's'.
+ */
+inline std::string str_tolower(std::string_view s) {
+	std::string lower(s);
+	for (char& c : lower)
+		c = char(std::tolower((unsigned char)c));
+	return lower;
+}
+
+/**
+ * INI file built up in memory with the same results as a series of
+ * WritePrivateProfileString and WritePrivateProfileSection calls, then
+ * serialized with a single sequential write.
+ *
+ * Lines of a seeded file are kept as they are unless a key on them is
+ * changed. New keys go after the last non-blank line of their section,
+ * new sections go at the end of the file after a blank line, and lines
+ * end with "\r\n", all as the profile API does it.
+ */
+class IniWriter {
+public:
+	using Entries = std::vector<std::pair<std::string, std::string>>;
+
+	IniWriter() {
+		sections.emplace_back(); // lines before the first section header
+	}
+
+	/**
+	 * Seed the output with the contents of an INI file.
+	 *
+	 * @param path path to the INI file to copy.
+	 * @return true if the file was read, false if not.
+	 */
+	bool load(const std::filesystem::path& path) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in)
+			return false;
+		std::string raw;
+		Section* current = &sections.front();
+		while (std::getline(in, raw)) {
+			if (!raw.empty() && raw.back() == '\r')
+				raw.pop_back();
+			std::string_view line = str_trim(raw);
+			if (!line.empty() && line[0] == '[') {
+				size_t close = line.find(']');
+				std::string name(str_trim(line.substr(1, (close == std::string_view::npos) ? close : close - 1)));
+				current = &sections[add_section(name)];
+				current->header = raw;
+				continue;
+			}
+			size_t eq = line.find('=');
+			if (line.empty() || line[0] == ';' || eq == std::string_view::npos) {
+				current->lines.push_back(Line{ raw });
+				continue;
+			}
+			std::string_view key = str_trim(line.substr(0, eq));
+			current->keys.emplace(str_tolower(key), current->lines.size());
+			current->lines.push_back(Line{ raw, size_t(key.data() - raw.data()), key.size() });
+		}
+		return true;
+	}
+
+	/**
+	 * Set the value of a key, equivalent to WritePrivateProfileString.
+	 *
+	 * @param section name of the section to write the key in.
+	 * @param key name of the key to write.
+	 * @param value value to write.
+	 */
+	void set(std::string_view section, std::string_view key, std::string_view value) {
+		Section& s = sections[find_or_add_section(section)];
+		auto found = s.keys.find(lowered(key));
+		if (found != s.keys.end()) {
+			Line& l = s.lines[found->second];
+			std::string raw;
+			raw.reserve(l.keySize + 1 + value.size());
+			((raw += l.key()) += '=') += value;
+			l = Line{ std::move(raw), 0, l.keySize };
+			return;
+		}
+		// new keys go after the last non-blank line, blank lines stay at the end of the section
+		size_t pos = s.lines.size();
+		while (pos > 0 && str_trim(s.lines[pos - 1].raw).empty())
+			--pos;
+		if (pos < s.lines.size())
+			for (auto& [k, i] : s.keys)
+				if (i >= pos)
+					++i;
+		std::string raw;
+		raw.reserve(key.size() + 1 + value.size());
+		((raw += key) += '=') += value;
+		s.lines.insert(s.lines.begin() + pos, Line{ std::move(raw), 0, key.size() });
+		s.keys.emplace(lower, pos);
+	}
+
+	/**
+	 * Replace the contents of a section, equivalent to WritePrivateProfileSection.
+	 *
+	 * @param section name of the section to write.
+	 * @param entries key/value pairs to write in the section.
+	 */
+	void set_section(std::string_view section, const Entries& entries) {
+		Section& s = sections[find_or_add_section(section)];
+		std::vector<Line> trailing; // keep blank lines separating this section from the next one
+		while (!s.lines.empty() && str_trim(s.lines.back().raw).empty()) {
+			trailing.push_back(std::move(s.lines.back()));
+			s.lines.pop_back();
+		}
+		s.lines.clear();
+		s.keys.clear();
+		for (const auto& [key, value] : entries) {
+			s.keys.emplace(str_tolower(key), s.lines.size());
+			s.lines.push_back(Line{ key + '=' + value, 0, key.size() });
+		}
+		s.lines.insert(s.lines.end(), trailing.rbegin(), trailing.rend());
+	}
+
+	/**
+	 * Delete a key, equivalent to WritePrivateProfileString with a null value.
+	 * Every line of the section with that key goes, so a repeated key can't
+	 * show through once the first one is gone.
+	 *
+	 * @param section name of the section the key is in.
+	 * @param key name of the key to delete.
+	 */
+	void remove(std::string_view section, std::string_view key) {
+		auto foundSection = sectionIndex.find(lowered(section));
+		if (foundSection == sectionIndex.end())
+			return;
+		Section& s = sections[foundSection->second];
+		if (s.keys.find(lowered(key)) == s.keys.end())
+			return;
+		s.lines.erase(std::remove_if(s.lines.begin(), s.lines.end(),
+			[&](const Line& l) { return l.keySize > 0 && str_iequals(l.key(), key); }), s.lines.end());
+		s.keys.clear();
+		for (size_t i = 0; i < s.lines.size(); ++i)
+			if (s.lines[i].keySize > 0)
+				s.keys.emplace(str_tolower(s.lines[i].key()), i);
+	}
+
+	/**
+	 * Delete a section with everything in it, equivalent to
+	 * WritePrivateProfileString with a null key.
+	 *
+	 * @param section name of the section to delete.
+	 */
+	void remove_section(std::string_view section) {
+		auto found = sectionIndex.find(lowered(section));
+		if (found == sectionIndex.end())
+			return;
+		Section& s = sections[found->second];
+		s.header.clear(); // left in place as an empty section, so the indices of the others don't move
+		s.lines.clear();
+		s.keys.clear();
+		sectionIndex.erase(found);
+	}
+
+	/**
+	 * Add a line after the last section, like appending to the finished file.
+	 *
+	 * @param line text of the line to add.
+	 */
+	void append_line(std::string_view line) {
+		trailer.emplace_back(line);
+	}
+
+	/**
+	 * Serialize the whole file into a single string.
+	 *
+	 * @return contents of the INI file.
+	 */
+	std::string str() const {
+		std::string out;
+		for (const Section& s : sections) {
+			if (!s.header.empty())
+				(out += s.header) += "\r\n";
+			for (const Line& l : s.lines)
+				(out += l.raw) += "\r\n";
+		}
+		for (const std::string& l : trailer)
+			(out += l) += "\r\n";
+		return out;
+	}
+
+	/**
+	 * Write the file to disk with one sequential write.
+	 *
+	 * @param path path to write the file to.
+	 * @return true if the file was written, false if not.
+	 */
+	bool save(const std::filesystem::path& path) const {
+		std::string out = str();
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(out.data(), out.size());
+		return bool(file);
+	}
+
+	/**
+	 * Write the file to a temporary file next to it, then move that over the
+	 * original, so anything reading the file never sees it half written.
+	 *
+	 * @param path path to write the file to.
+	 * @return true if the file was replaced, false if not.
+	 */
+	bool save_replace(const std::filesystem::path& path) const {
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		if (!save(temp))
+			return false;
+		std::error_code ec;
+		std::filesystem::rename(temp, path, ec);
+		if (!ec)
+			return true;
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+private:
+	struct Line {
+		std::string raw; // the whole line as it's written
+		size_t keyStart = 0; // where the key is in 'raw'
+		size_t keySize = 0; // 0 for comments and blank lines
+
+		std::string_view key() const {
+			return std::string_view(raw).substr(keyStart, keySize);
+		}
+	};
+
+	struct Section {
+		std::string header; // empty for the lines before the first section
+		std::vector<Line> lines;
+		std::unordered_map<std::string, size_t> keys; // lowercase key -> index in lines
+	};
+
+	/**
+	 * Find a section by name, or add it if it doesn't exist.
+	 *
+	 * @param name name of the section.
+	 * @return index of the section.
+	 */
+	size_t find_or_add_section(std::string_view name) {
+		auto found = sectionIndex.find(lowered(name));
+		if (found != sectionIndex.end())
+			return found->second;
+		// separate the new section from the previous one with a blank line
+		Section& last = sections.back();
+		bool fileEmpty = sections.size() == 1 && last.lines.empty();
+		bool endsBlank = !last.lines.empty() && str_trim(last.lines.back().raw).empty();
+		if (!fileEmpty && !endsBlank)
+			last.lines.push_back(Line{});
+		size_t i = add_section(std::string(name));
+		sections[i].header = '[' + std::string(name) + ']';
+		return i;
+	}
+
+	/**
+	 * Add a section to the end of the file. A repeated section
+	 * keeps its lines, but only the first one is ever written to.
+	 *
+	 * @param name name of the section.
+	 * @return index of the new section.
+	 */
+	size_t add_section(const std::string& name) {
+		sectionIndex.emplace(str_tolower(name), sections.size());
+		sections.emplace_back();
+		return sections.size() - 1;
+	}
+
+	/**
+	 * Lowercase a name into a buffer which is reused, so looking up names
+	 * which are already there doesn't allocate.
+	 *
+	 * @param s name to lowercase.
+	 * @return the lowercase name, until the next call.
+	 */
+	const std::string& lowered(std::string_view s) {
+		lower.assign(s.data(), s.size());
+		for (char& c : lower)
+			c = char(std::tolower((unsigned char)c));
+		return lower;
+	}
+
+	std::vector<Section> sections;
+	std::unordered_map<std::string, size_t> sectionIndex; // lowercase name -> index in sections
+	std::string lower; // buffer for lowered
+	std::vector<std::string> trailer;
+};
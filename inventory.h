@@ -0,0 +1,165 @@
+/**
+ * @file inventory.h
+ * @brief Every map and preview in the map tree, from a single walk of it.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "mapcache.h"
+
+/**
+ * Spell a directory the way the paths of the files under it start, with
+ * exactly one separator after it, whether or not it was given with one.
+ *
+ * @param root directory, CnCNet.
+ * @return the directory followed by a separator.
+ */
+inline std::string root_prefix(const std::filesystem::path& root) {
+	std::string prefix = root.string();
+	if (root.has_filename()) // "C:\CnCNet\" or "/srv/cncnet/" already end in one
+		prefix += char(std::filesystem::path::preferred_separator);
+	return prefix;
+}
+
+/**
+ * Maps and previews found in the map tree, with their sizes and modification
+ * times and each map paired with its preview.
+ *
+ * The tree is walked once and everything after that (the versionconfig.ini
+ * list, reading maps, the cache, the snapshot) works off this list. Paths are
+ * stored relative to CnCNet, back to back in one string, so a tree of thousands
+ * of files costs a handful of allocations instead of several per file.
+ */
+class FileInventory {
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	struct File {
+		uint32_t offset; // of the path in the arena
+		uint32_t length;
+		FileStamp stamp;
+		bool isMap;
+		uint32_t preview = NONE; // index of the preview of a map
+	};
+
+	/**
+	 * Walk a directory and add every map and preview in it.
+	 *
+	 * @param root directory paths are made relative to, CnCNet.
+	 * @param dir directory to walk.
+	 */
+	void scan(const std::filesystem::path& root, const std::filesystem::path& dir) {
+		size_t rootLength = root_prefix(root).length();
+		std::error_code ec;
+		for (const auto& e : std::filesystem::recursive_directory_iterator(dir)) {
+			const auto& native = e.path().native(); // no copy, unlike string() or extension()
+			bool isMap = ends_with(native, ".map");
+			if (!isMap && !ends_with(native, ".png"))
+				continue;
+			// on Windows the walk has already read these, elsewhere it's one stat
+			FileStamp stamp;
+			stamp.size = e.file_size(ec);
+			if (!ec)
+				stamp.mtime = e.last_write_time(ec).time_since_epoch().count();
+			if (ec)
+				stamp = FileStamp();
+			std::string full = e.path().string();
+			add(std::string_view(full).substr(rootLength), stamp, isMap);
+		}
+		pair_previews();
+	}
+
+	/**
+	 * Add a single file, for building an inventory from something other than the tree.
+	 * Call pair_previews() once every file has been added.
+	 *
+	 * @param path path of the file relative to CnCNet.
+	 * @param stamp size and modification time of the file.
+	 * @param isMap true for a map, false for a preview.
+	 */
+	void add(std::string_view path, const FileStamp& stamp, bool isMap) {
+		files.push_back(File{ uint32_t(arena.size()), uint32_t(path.size()), stamp, isMap });
+		arena += path;
+		if (isMap)
+			mapIndexes.push_back(uint32_t(files.size() - 1));
+	}
+
+	/**
+	 * Pair every map with the preview next to it, if there is one.
+	 */
+	void pair_previews() {
+		std::unordered_map<std::string_view, uint32_t> previews; // path without the extension
+		for (uint32_t i = 0; i < files.size(); ++i)
+			if (!files[i].isMap)
+				previews.emplace(stem(i), i);
+		for (uint32_t i : mapIndexes) {
+			auto found = previews.find(stem(i));
+			files[i].preview = (found == previews.end()) ? NONE : found->second;
+		}
+	}
+
+	size_t size() const {
+		return files.size();
+	}
+
+	const File& file(size_t i) const {
+		return files[i];
+	}
+
+	/**
+	 * Get the path of a file relative to CnCNet.
+	 *
+	 * @param i index of the file.
+	 * @return path of the file, valid as long as the inventory isn't added to.
+	 */
+	std::string_view path(size_t i) const {
+		return std::string_view(arena.data() + files[i].offset, files[i].length);
+	}
+
+	/**
+	 * Get the size and modification time of a map's preview.
+	 *
+	 * @param i index of the map.
+	 * @return stamp of the preview, zeroed if the map has none.
+	 */
+	FileStamp preview_stamp(size_t i) const {
+		return (files[i].preview == NONE) ? FileStamp() : files[files[i].preview].stamp;
+	}
+
+	/**
+	 * Get the indexes of every map, in the order they were found.
+	 *
+	 * @return indexes of the maps.
+	 */
+	const std::vector<uint32_t>& maps() const {
+		return mapIndexes;
+	}
+
+private:
+	template <class String>
+	static bool ends_with(const String& s, const char* ext) {
+		size_t n = std::char_traits<char>::length(ext);
+		if (s.length() < n)
+			return false;
+		for (size_t i = 0; i < n; ++i)
+			if (s[s.length() - n + i] != typename String::value_type(ext[i]))
+				return false;
+		return true;
+	}
+
+	std::string_view stem(size_t i) const {
+		return path(i).substr(0, files[i].length - 4);
+	}
+
+	std::string arena;
+	std::vector<File> files;
+	std::vector<uint32_t> mapIndexes;
+};
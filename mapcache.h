@@ -0,0 +1,415 @@
+/**
+ * @file mapcache.h
+ * @brief Data read from maps, kept between runs so unchanged maps aren't read again.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mapdata.h"
+#include "platform.h"
+#include "xxhash.h"
+
+// bump whenever MapData or what read_map_data reads changes, older caches are then ignored
+#define MAPCACHE_VERSION 2
+
+/**
+ * Size and modification time of a file, zero for both if it doesn't exist.
+ */
+struct FileStamp {
+	uint64_t size = 0;
+	int64_t mtime = 0;
+
+	bool operator==(const FileStamp& other) const {
+		return size == other.size && mtime == other.mtime;
+	}
+	bool operator!=(const FileStamp& other) const {
+		return !(*this == other);
+	}
+};
+
+/**
+ * Get the size and modification time of a file.
+ *
+ * @param path path to the file.
+ * @return stamp of the file, zeroed if it doesn't exist.
+ */
+inline FileStamp file_stamp(const std::filesystem::path& path) {
+	std::error_code ec;
+	FileStamp stamp;
+	stamp.size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return FileStamp();
+	stamp.mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+	return stamp;
+}
+
+/**
+ * Data read from every map on the last run, keyed by the map's path relative to CnCNet.
+ *
+ * Only what comes from the map and its preview is cached. Everything taken from the
+ * old MPMaps.ini and MPMapsBase.ini is looked up again on every run, so changes to
+ * either of them always show up without having to throw the cache away.
+ */
+class MapCache {
+public:
+	struct Entry {
+		FileStamp map;
+		uint64_t hash = 0; // XXH64 of the map, 0 if it was never hashed
+		FileStamp preview;
+		MapData data;
+	};
+
+	/**
+	 * Read the cache from disk.
+	 *
+	 * @param path path to the cache file.
+	 * @return true if the cache was read, false if it's missing, from another version or damaged.
+	 */
+	bool load(const std::filesystem::path& path) {
+		entries.clear();
+		std::ifstream in(path, std::ios::binary);
+		if (!in || read_u64(in) != MAGIC || read_u64(in) != MAPCACHE_VERSION)
+			return false;
+		uint64_t count = read_u64(in);
+		for (uint64_t n = 0; n < count && in; ++n) {
+			std::string key = read_str(in);
+			Entry e;
+			e.map.size = read_u64(in);
+			e.map.mtime = int64_t(read_u64(in));
+			e.hash = read_u64(in);
+			e.preview.size = read_u64(in);
+			e.preview.mtime = int64_t(read_u64(in));
+			MapData& m = e.data;
+			for (std::string* s : map_data_strings(m))
+				*s = read_str(in);
+			for (std::vector<std::string>* list : { &m.enemyHouses, &m.waypoints }) {
+				list->resize(read_u64(in));
+				for (std::string& s : *list)
+					s = read_str(in);
+			}
+			for (IniWriter::Entries* forced : { &m.forcedOptions, &m.forcedSpawnIniOptions }) {
+				forced->resize(read_u64(in));
+				for (auto& [key, value] : *forced) {
+					key = read_str(in);
+					value = read_str(in);
+				}
+			}
+			m.hasPreview = read_u64(in) != 0;
+			m.previewSize.first = int(read_u64(in));
+			m.previewSize.second = int(read_u64(in));
+			entries.emplace(std::move(key), std::move(e));
+		}
+		if (!in) {
+			entries.clear();
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Write the cache to disk.
+	 *
+	 * @param path path to the cache file.
+	 * @return true if the cache was written, false if not.
+	 */
+	bool save(const std::filesystem::path& path) const {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		write_u64(out, MAGIC);
+		write_u64(out, MAPCACHE_VERSION);
+		write_u64(out, entries.size());
+		for (const auto& [key, e] : entries) {
+			write_str(out, key);
+			write_u64(out, e.map.size);
+			write_u64(out, uint64_t(e.map.mtime));
+			write_u64(out, e.hash);
+			write_u64(out, e.preview.size);
+			write_u64(out, uint64_t(e.preview.mtime));
+			const MapData& m = e.data;
+			for (const std::string* s : map_data_strings(m))
+				write_str(out, *s);
+			for (const std::vector<std::string>* list : { &m.enemyHouses, &m.waypoints }) {
+				write_u64(out, list->size());
+				for (const std::string& s : *list)
+					write_str(out, s);
+			}
+			for (const IniWriter::Entries* forced : { &m.forcedOptions, &m.forcedSpawnIniOptions }) {
+				write_u64(out, forced->size());
+				for (const auto& [key, value] : *forced) {
+					write_str(out, key);
+					write_str(out, value);
+				}
+			}
+			write_u64(out, m.hasPreview);
+			write_u64(out, uint64_t(m.previewSize.first));
+			write_u64(out, uint64_t(m.previewSize.second));
+		}
+		return bool(out);
+	}
+
+	/**
+	 * Write the cache to a temporary file next to it, then move that over the
+	 * old cache, so another run never loads it half written.
+	 *
+	 * @param path path to the cache file.
+	 * @return true if the cache was replaced, false if not.
+	 */
+	bool save_replace(const std::filesystem::path& path) const {
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		if (!save(temp))
+			return false;
+		std::error_code ec;
+		std::filesystem::rename(temp, path, ec);
+		if (!ec)
+			return true;
+		std::filesystem::remove(temp, ec);
+		return false;
+	}
+
+	/**
+	 * Find the cached data for a map.
+	 *
+	 * @param key path of the map relative to CnCNet.
+	 * @return pointer to the entry, nullptr if the map isn't cached.
+	 */
+	const Entry* find(const std::string& key) const {
+		auto found = entries.find(key);
+		return (found == entries.end()) ? nullptr : &found->second;
+	}
+
+	/**
+	 * Add or replace the cached data for a map.
+	 *
+	 * @param key path of the map relative to CnCNet.
+	 * @param entry data for the map.
+	 */
+	void set(const std::string& key, Entry entry) {
+		entries[key] = std::move(entry);
+	}
+
+	/**
+	 * Remove every map from the cache.
+	 */
+	void clear() {
+		entries.clear();
+	}
+
+	size_t size() const {
+		return entries.size();
+	}
+
+private:
+	static constexpr uint64_t MAGIC = 0x4548434143554D52ull; // "RMUCACHE"
+
+	static void write_u64(std::ostream& out, uint64_t x) {
+		out.write((const char*)&x, sizeof(x));
+	}
+
+	static void write_str(std::ostream& out, const std::string& s) {
+		write_u64(out, s.size());
+		out.write(s.data(), s.size());
+	}
+
+	static uint64_t read_u64(std::istream& in) {
+		uint64_t x = 0;
+		in.read((char*)&x, sizeof(x));
+		return x;
+	}
+
+	static std::string read_str(std::istream& in) {
+		uint64_t len = read_u64(in);
+		if (!in || len > (1u << 24)) { // no value in a map is anywhere near 16 MB, the file is damaged
+			in.setstate(std::ios::failbit);
+			return std::string();
+		}
+		std::string s(size_t(len), '\0');
+		in.read(s.data(), s.size());
+		return s;
+	}
+
+	std::unordered_map<std::string, Entry> entries;
+};
+
+/**
+ * Maps read during a run, by their size and the hash of their content, so a
+ * map which was copied to several places is only parsed once. Only maps whose
+ * size is shared with another map can be copies, so only those are hashed.
+ * Sizes are counted before any map is read, after that it's safe to use from
+ * every thread of the pool at once.
+ */
+class SharedMaps {
+public:
+	/**
+	 * Count the size of a map which is about to be read.
+	 *
+	 * @param size size of the map in bytes.
+	 */
+	void count_size(uint64_t size) {
+		++sizes[size];
+	}
+
+	/**
+	 * Check if a map could be a copy of another, because another map has its size.
+	 *
+	 * @param size size of the map in bytes.
+	 * @return true if the map is worth hashing, false if it can't have a copy.
+	 */
+	bool may_share(uint64_t size) const {
+		auto found = sizes.find(size);
+		return found != sizes.end() && found->second > 1;
+	}
+
+	/**
+	 * Look for a map which was already read.
+	 *
+	 * @param size size of the map in bytes.
+	 * @param hash XXH64 of the map.
+	 * @param data set to what was read from the map, if it was found.
+	 * @return true if the map was found, false if not.
+	 */
+	bool find(uint64_t size, uint64_t hash, MapData& data) const {
+		std::lock_guard<std::mutex> l(lock);
+		auto found = maps.find(Key{ size, hash });
+		if (found == maps.end())
+			return false;
+		data = found->second;
+		return true;
+	}
+
+	/**
+	 * Add a map which was just read.
+	 *
+	 * @param size size of the map in bytes.
+	 * @param hash XXH64 of the map.
+	 * @param data what was read from the map.
+	 */
+	void add(uint64_t size, uint64_t hash, const MapData& data) {
+		std::lock_guard<std::mutex> l(lock);
+		maps.emplace(Key{ size, hash }, data);
+	}
+
+private:
+	struct Key {
+		uint64_t size;
+		uint64_t hash;
+
+		bool operator==(const Key& other) const {
+			return size == other.size && hash == other.hash;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& k) const {
+			return size_t(k.hash ^ (k.size * 0x9E3779B97F4A7C15ull));
+		}
+	};
+
+	mutable std::mutex lock;
+	std::unordered_map<Key, MapData, KeyHash> maps;
+	std::unordered_map<uint64_t, uint32_t> sizes; // number of maps of each size
+};
+
+/**
+ * Read a map, unless a map with the same content was already read. A map is
+ * only hashed if another map has the same size, and then from the same mapping
+ * it's scanned from, so it's only read from disk once.
+ *
+ * @param mapPath path to the map.
+ * @param shared maps already read, the map is added to it if it wasn't there.
+ * @param stats counters to add the bytes read and hashed to.
+ * @param hash set to the XXH64 of the map, 0 if it couldn't be read or wasn't hashed.
+ * @param duplicate set to true if the data was taken from a map with the same content.
+ * @return data of the map.
+ */
+inline MapData read_map_shared(const std::filesystem::path& mapPath, SharedMaps& shared, ScanStats& stats, uint64_t& hash, bool& duplicate) {
+	duplicate = false;
+	hash = 0;
+	MappedFile file(mapPath);
+	if (!file.is_open())
+		return MapData();
+	MapData data;
+	if (shared.may_share(file.size())) {
+		Xxh64 h;
+		h.update(file.view().data(), file.size());
+		hash = h.digest();
+		stats.bytesHashed += file.size();
+		if (shared.find(file.size(), hash, data)) {
+			duplicate = true;
+			return data;
+		}
+	}
+	++stats.files;
+	stats.bytesTotal += file.size();
+	data = map_data_from_ini(scan_map_view(file.view(), mapSectionsUsed, stats));
+	if (hash != 0)
+		shared.add(file.size(), hash, data);
+	return data;
+}
+
+/**
+ * Get a map's data from the cache if the map hasn't changed, otherwise read it.
+ *
+ * A map is unchanged if its size and modification time match the cache, or if its
+ * size matches and its content hashes the same (e.g. a fresh checkout touching every
+ * file), which is only known for maps which were hashed because another map had
+ * their size. Previews aren't read here, 'previewStale' says whether the entry's
+ * preview size has to be read again with read_preview_size, so a changed preview
+ * doesn't mean reading the map again.
+ *
+ * @param cache data from the last run.
+ * @param key path of the map relative to CnCNet.
+ * @param mapPath path to the map.
+ * @param mapStamp size and modification time of the map.
+ * @param previewStamp size and modification time of its preview, zeroed if it has none.
+ * @param shared maps already read this run, by content.
+ * @param stats counters to add the bytes read from the map to.
+ * @param reused set to true if the cached data was used, false if the map was read.
+ * @param previewStale set to true if the preview size has to be read.
+ * @param duplicate set to true if the map wasn't in the cache, but a map with the same content was already read.
+ * @return entry for the map, to go in the next cache.
+ */
+inline MapCache::Entry read_map_cached(const MapCache& cache, const std::string& key, const std::filesystem::path& mapPath,
+		const FileStamp& mapStamp, const FileStamp& previewStamp, SharedMaps& shared, ScanStats& stats, bool& reused,
+		bool& previewStale, bool& duplicate) {
+	MapCache::Entry e;
+	e.map = mapStamp;
+	e.preview = previewStamp;
+
+	const MapCache::Entry* old = cache.find(key);
+	reused = false;
+	duplicate = false;
+	if (old != nullptr) {
+		if (old->map == e.map) {
+			e.hash = old->hash;
+			reused = true;
+		}
+		else if (old->map.size == e.map.size && old->hash != 0) {
+			e.hash = xxh64_file(mapPath);
+			stats.bytesHashed += e.map.size;
+			reused = (e.hash == old->hash);
+		}
+	}
+	if (reused) {
+		e.data = old->data;
+		previewStale = (e.preview != old->preview);
+		if (e.hash == 0 && shared.may_share(e.map.size)) { // a copy of it may have turned up since it was cached
+			e.hash = xxh64_file(mapPath);
+			stats.bytesHashed += e.map.size;
+		}
+		if (e.hash != 0) // so copies of it which aren't cached yet don't have to be read
+			shared.add(e.map.size, e.hash, e.data);
+		return e;
+	}
+
+	e.data = read_map_shared(mapPath, shared, stats, e.hash, duplicate);
+	previewStale = true;
+	return e;
+}
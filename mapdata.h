@@ -0,0 +1,149 @@
+/**
+ * @file mapdata.h
+ * @brief Reading everything we use from a map and its preview.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "inidocument.h"
+#include "iniwriter.h"
+#include "mapscanner.h"
+#include "platform.h"
+
+// bytes at the start of a PNG which hold its dimensions
+const size_t pngHeaderSize = 24;
+
+/**
+ * https://stackoverflow.com/questions/5354459/c-how-to-get-the-image-size-of-a-png-file-in-directory#answer-5354657
+ * Gets the dimensions of a PNG image
+ * in a path as a pair of integers.
+ *
+ * @param pngPath path to the PNG image to get the dimensions of.
+ * @return pair of integers containing the dimensions.
+ */
+inline std::pair<int, int> png_getsize(const std::filesystem::path& pngPath) {
+	// signature, then the IHDR chunk with the width and height at 16 and 20
+	unsigned char header[pngHeaderSize];
+	size_t n = read_file_at(pngPath, 0, header, sizeof(header));
+	if (n == 0)
+		throw std::invalid_argument("no file at specified path");
+	if (n < sizeof(header) || read_be32(header) != 0x89504E47)
+		throw std::invalid_argument("specified file is not a png");
+	return std::pair<int, int>(int(read_be32(header + 16)), int(read_be32(header + 20)));
+}
+
+// sections of a map we read, everything else is skipped
+const std::vector<std::string_view> mapSectionsUsed = { "Basic", "Map", "Waypoints", "ForcedOptions", "ForcedSpawnIniOptions" };
+
+// numbered keys looked up for every map, spelled out once instead of being built for every lookup
+const std::array<std::string_view, 9> enemyHouseKeys = { "EnemyHouse0", "EnemyHouse1", "EnemyHouse2", "EnemyHouse3",
+	"EnemyHouse4", "EnemyHouse5", "EnemyHouse6", "EnemyHouse7", "EnemyHouse8" };
+const std::array<std::string_view, 9> waypointNumbers = { "0", "1", "2", "3", "4", "5", "6", "7", "8" };
+const std::array<std::string_view, 9> waypointKeys = { "Waypoint0", "Waypoint1", "Waypoint2", "Waypoint3",
+	"Waypoint4", "Waypoint5", "Waypoint6", "Waypoint7", "Waypoint8" };
+
+/**
+ * Everything we use from a map and its preview, read once
+ * so the file can be closed before MPMaps.ini is built.
+ */
+struct MapData {
+	std::string name;
+	std::string author;
+	std::string briefing;
+	std::string gameMode;
+	std::string isCoopMission;
+	std::string disallowedPlayerSides;
+	std::string disallowedPlayerColors;
+	std::vector<std::string> enemyHouses; // EnemyHouse0-8 up to the first one missing
+	std::vector<std::string> waypoints; // waypoints 0-8 up to the first one missing
+	IniWriter::Entries forcedOptions;
+	IniWriter::Entries forcedSpawnIniOptions;
+	std::string size;
+	std::string localSize;
+	bool hasPreview = false;
+	std::pair<int, int> previewSize;
+};
+
+/**
+ * List every single string in MapData, in the order they're saved in.
+ *
+ * @param m data to list the strings of, const or not.
+ * @return array of pointers to the strings.
+ */
+template <class Data>
+auto map_data_strings(Data& m) {
+	return std::array{ &m.name, &m.author, &m.briefing, &m.gameMode, &m.isCoopMission,
+		&m.disallowedPlayerSides, &m.disallowedPlayerColors, &m.size, &m.localSize };
+}
+
+/**
+ * Read the size of a map's PNG preview.
+ *
+ * @param map data to set the preview size in.
+ * @param pngPath path to the preview.
+ */
+inline void read_preview_size(MapData& map, const std::filesystem::path& pngPath) {
+	try {
+		map.previewSize = png_getsize(pngPath);
+		map.hasPreview = true;
+	}
+	catch (const std::invalid_argument&) { // no preview, noted when the section is built
+		map.hasPreview = false;
+	}
+}
+
+/**
+ * Take everything we use from the sections scanned out of a map.
+ *
+ * @param mapIni sections of the map, as returned by scan_map.
+ * @return data of the map, without its preview.
+ */
+inline MapData map_data_from_ini(const IniDocument& mapIni) {
+	MapData map;
+	map.name = mapIni.get("Basic", "Name");
+	map.author = mapIni.get("Basic", "Author");
+	map.briefing = mapIni.get("Basic", "Briefing");
+	map.gameMode = mapIni.get("Basic", "GameMode");
+	map.isCoopMission = mapIni.get("Basic", "IsCoopMission");
+	map.disallowedPlayerSides = mapIni.get("Basic", "DisallowedPlayerSides");
+	map.disallowedPlayerColors = mapIni.get("Basic", "DisallowedPlayerColors");
+	for (size_t n = 0; n <= 8; ++n) {
+		std::string_view enemyHouse = mapIni.get("Basic", enemyHouseKeys[n]);
+		if (enemyHouse.empty())
+			break;
+		map.enemyHouses.emplace_back(enemyHouse);
+	}
+	for (size_t n = 0; n <= 8; ++n) {
+		std::string_view waypoint = mapIni.get("Waypoints", waypointNumbers[n]);
+		if (waypoint.empty())
+			break;
+		map.waypoints.emplace_back(waypoint);
+	}
+	for (auto [forcedKey, forcedEntries] : { std::pair("ForcedOptions", &map.forcedOptions),
+			std::pair("ForcedSpawnIniOptions", &map.forcedSpawnIniOptions) })
+		if (const IniDocument::Section* forcedSection = mapIni.section(forcedKey))
+			for (const IniDocument::Entry& e : forcedSection->entries)
+				forcedEntries->emplace_back(e.key, e.value);
+	map.size = mapIni.get("Map", "Size");
+	map.localSize = mapIni.get("Map", "LocalSize");
+	return map;
+}
+
+/**
+ * Read everything we use from a map itself, its preview is read separately
+ * with read_preview_size.
+ *
+ * @param mapPath path to the map.
+ * @param stats counters to add the bytes read from the map to.
+ * @return data read from the map.
+ */
+inline MapData read_map_data(const std::filesystem::path& mapPath, ScanStats& stats) {
+	return map_data_from_ini(scan_map(mapPath, mapSectionsUsed, stats));
+}
@@ -0,0 +1,205 @@
+/**
+ * @file mapscanner.h
+ * @brief Streaming reader which pulls only the needed sections out of a map.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "inidocument.h"
+#include "platform.h"
+
+/**
+ * Byte counts collected while scanning maps.
+ */
+struct ScanStats {
+	uint64_t files = 0;
+	uint64_t bytesTotal = 0;  // size of every scanned file
+	uint64_t bytesRead = 0;   // bytes looked at before we stopped
+	uint64_t bytesParsed = 0; // bytes of wanted sections handed to the parser
+	uint64_t bytesHashed = 0; // bytes of maps hashed to find copies, on top of what was looked at
+
+	/**
+	 * Byte count for everything that was never tokenized, either because it
+	 * was in a section we don't use or because we stopped before reaching it.
+	 *
+	 * @return number of bytes skipped.
+	 */
+	uint64_t bytes_skipped() const {
+		return bytesTotal - bytesParsed;
+	}
+
+	ScanStats& operator+=(const ScanStats& other) {
+		files += other.files;
+		bytesTotal += other.bytesTotal;
+		bytesRead += other.bytesRead;
+		bytesParsed += other.bytesParsed;
+		bytesHashed += other.bytesHashed;
+		return *this;
+	}
+};
+
+// the bulk of a map, base64 packs of its terrain and overlay which the sections we read come before or after
+const std::vector<std::string_view> mapBodySections = { "IsoMapPack5", "OverlayPack", "OverlayDataPack" };
+
+/**
+ * Get the name of a section from its header line.
+ *
+ * @param line trimmed line starting with '['.
+ * @return name of the section.
+ */
+inline std::string_view section_name(std::string_view line) {
+	size_t close = line.find(']');
+	return str_trim(line.substr(1, (close == std::string_view::npos) ? close : close - 1));
+}
+
+/**
+ * Index only the sections we need from a map which is already in memory.
+ *
+ * Most of a map is base64 payload ([IsoMapPack5], [OverlayPack], [PreviewPack]...)
+ * which we never look at, so rather than tokenizing every line, sections we don't
+ * want are skipped by searching for the next '[' that starts a line, which can't
+ * appear in base64.
+ *
+ * Map editors write most of the sections we read before and after the map body,
+ * so the map is read from the start up to the body, then from the end back to
+ * the body. Only if a wanted section wasn't in either of them is the body
+ * searched, as a section can sit anywhere in it, even between two of its packs.
+ *
+ * @param data whole content of the map.
+ * @param wanted names of the sections to keep.
+ * @param stats counters to add the bytes looked at and skipped to.
+ * @return document containing only the wanted sections.
+ */
+inline IniDocument scan_map_view(std::string_view data, const std::vector<std::string_view>& wanted, ScanStats& stats) {
+	std::vector<char> out;
+	std::vector<bool> seen(wanted.size(), false);
+	size_t seenCount = 0;
+	// mark a section as seen, returns the index of it in 'wanted', or wanted.size() if it isn't wanted or was seen before
+	auto want = [&](std::string_view name) {
+		for (size_t i = 0; i < wanted.size(); ++i) {
+			if (!seen[i] && str_iequals(name, wanted[i])) {
+				seen[i] = true;
+				++seenCount;
+				return i;
+			}
+		}
+		return wanted.size();
+	};
+	auto is_body = [](std::string_view name) {
+		for (std::string_view body : mapBodySections)
+			if (str_iequals(name, body))
+				return true;
+		return false;
+	};
+
+	// read forward from a line start, stopping once every wanted section has been seen or, if asked to, at the map body
+	auto scan_forward = [&](size_t pos, size_t end, bool stopAtBody) {
+		bool keep = false;
+		while (pos < end) {
+			size_t nl = data.find('\n', pos);
+			size_t lineEnd = (nl == std::string_view::npos || nl >= end) ? end : nl + 1;
+			std::string_view line = str_trim(data.substr(pos, lineEnd - pos));
+
+			if (!line.empty() && line[0] == '[') {
+				std::string_view name = section_name(line);
+				if (stopAtBody && is_body(name))
+					break;
+				keep = want(name) < wanted.size();
+				if (!keep && seenCount == wanted.size())
+					break; // every section we want has been read
+			}
+
+			if (keep) {
+				out.insert(out.end(), data.data() + pos, data.data() + lineEnd);
+				pos = lineEnd;
+				continue;
+			}
+
+			// skip ahead to the next '[' at the start of a line
+			pos = lineEnd;
+			while (pos < end) {
+				const char* bracket = (const char*)std::memchr(data.data() + pos, '[', end - pos);
+				if (bracket == nullptr) {
+					pos = end;
+					break;
+				}
+				size_t bracketPos = size_t(bracket - data.data());
+				size_t prevNl = data.rfind('\n', bracketPos);
+				size_t lineStart = (prevNl == std::string_view::npos || prevNl + 1 < pos) ? pos : prevNl + 1;
+				if (str_trim(data.substr(lineStart, bracketPos - lineStart)).empty()) {
+					pos = lineStart;
+					break;
+				}
+				// '[' in the middle of a line, carry on from the next line
+				size_t nextNl = data.find('\n', bracketPos);
+				pos = (nextNl == std::string_view::npos || nextNl >= end) ? end : nextNl + 1;
+			}
+		}
+		return pos;
+	};
+
+	size_t head = scan_forward(0, data.size(), true);
+	uint64_t looked = head;
+	if (seenCount < wanted.size() && head < data.size()) {
+		// walk back from the end one section at a time, until the body
+		std::vector<std::string_view> tail; // wanted sections found from the end, last one first
+		size_t end = data.size(), at = data.size();
+		while (at > head && seenCount < wanted.size()) {
+			size_t bracket = data.rfind('[', at - 1);
+			if (bracket == std::string_view::npos || bracket < head) {
+				at = head;
+				break;
+			}
+			size_t prevNl = data.rfind('\n', bracket);
+			size_t lineStart = (prevNl == std::string_view::npos) ? 0 : prevNl + 1;
+			at = lineStart;
+			if (!str_trim(data.substr(lineStart, bracket - lineStart)).empty())
+				continue; // '[' in the middle of a line
+			size_t headerEnd = data.find('\n', bracket);
+			std::string_view name = section_name(str_trim(data.substr(bracket, std::min(headerEnd, end) - bracket)));
+			if (is_body(name))
+				break;
+			size_t found = want(name);
+			if (found < wanted.size())
+				tail.push_back(data.substr(lineStart, end - lineStart));
+			end = lineStart;
+		}
+		looked += data.size() - at;
+
+		// a section inside the body, or one the map doesn't have, look for it the slow way
+		if (seenCount < wanted.size() && at > head)
+			looked += scan_forward(head, at, false) - head;
+		for (auto it = tail.rbegin(); it != tail.rend(); ++it)
+			out.insert(out.end(), it->begin(), it->end());
+	}
+
+	stats.bytesRead += looked;
+	stats.bytesParsed += out.size();
+	return IniDocument(std::move(out));
+}
+
+/**
+ * Read a map and index only the sections we need from it. The map is memory
+ * mapped, so the parts which are skipped over are never copied.
+ *
+ * @param path path to the map to read.
+ * @param wanted names of the sections to keep.
+ * @param stats counters to add the bytes looked at and skipped to.
+ * @return document containing only the wanted sections.
+ */
+inline IniDocument scan_map(const std::filesystem::path& path, const std::vector<std::string_view>& wanted, ScanStats& stats) {
+	MappedFile map(path);
+	if (!map.is_open())
+		return IniDocument(std::vector<char>());
+	++stats.files;
+	stats.bytesTotal += map.size();
+	return scan_map_view(map.view(), wanted, stats);
+}
@@ -0,0 +1,629 @@
+/**
+ * @file mpmaps.h
+ * @brief Every step from a map tree to a finished MPMaps.ini, without any user interaction.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+#include "inidocument.h"
+#include "iniwriter.h"
+#include "inventory.h"
+#include "mapcache.h"
+#include "mapdata.h"
+#include "patterns.h"
+#include "previewpack.h"
+#include "runstats.h"
+#include "snapshot.h"
+#include "strutil.h"
+#include "threadpool.h"
+
+/**
+ * Get the MPMaps.ini section name of a map, its path relative to CnCNet
+ * without the extension. Sections always use backslashes, whatever the
+ * platform's separator is.
+ *
+ * @param mapKey path of the map relative to CnCNet.
+ * @return section name of the map.
+ */
+inline std::string map_section(const std::string& mapKey) {
+	std::string section = str_cutends(mapKey, 0, 4);
+	std::replace(section.begin(), section.end(), '/', '\\');
+	return section;
+}
+
+/**
+ * Get the MPMaps.ini section name of a map, the same as above, in an arena.
+ *
+ * @param mapKey path of the map relative to CnCNet.
+ * @param arena arena to write the name into.
+ * @return section name of the map.
+ */
+inline std::string_view map_section(std::string_view mapKey, StringArena& arena) {
+	std::string_view section = arena.copy(mapKey.substr(0, (mapKey.size() > 4) ? mapKey.size() - 4 : 0));
+	std::replace((char*)section.data(), (char*)section.data() + section.size(), '/', '\\');
+	return section;
+}
+
+/**
+ * Write game modes the way MPMaps.ini has them, with the first "standard"
+ * called "battle" and every word capitalized.
+ *
+ * @param modes game modes as the map or the old MPMaps.ini has them.
+ * @param arena arena to write the result into.
+ * @return game modes to write.
+ */
+inline std::string_view game_modes_title(std::string_view modes, StringArena& arena) {
+	size_t pos = modes.find("standard");
+	std::string_view title = (pos == std::string_view::npos) ? arena.copy(modes)
+		: arena.concat({ modes.substr(0, pos), "battle", modes.substr(pos + 8) });
+	str_titlecase((char*)title.data(), title.size());
+	return title;
+}
+
+/**
+ * Everything written to MPMaps.ini for a single map. It only points at the
+ * map's data, the old MPMaps.ini and the arena it was built in, so all of
+ * those have to outlive it.
+ */
+struct MapRecord {
+	std::string_view section;
+	std::vector<std::pair<std::string_view, std::string_view>> keys; // keys of the map's own section, in the order they're written
+	std::vector<std::pair<std::string_view, const IniWriter::Entries*>> sections; // ForcedOptions sections
+	std::vector<std::string_view> notes; // comments on missing data
+	unsigned lookups = 0; // keys looked up in the old MPMaps.ini
+	unsigned fallbacks = 0; // lookups made because the map didn't have a usable value
+};
+
+/**
+ * Work out a map's MPMaps.ini entries from the map itself and the old MPMaps.ini.
+ *
+ * @param mapSection name of the map's section.
+ * @param mapTitle validated name of the map.
+ * @param map data read from the map.
+ * @param mpmapsOld the old MPMaps.ini.
+ * @param arena arena to write anything which isn't in the map or the old MPMaps.ini into.
+ * @return entries and notes for the map.
+ */
+inline MapRecord build_map_record(std::string_view mapSection, std::string_view mapTitle, const MapData& map, const IniDocument& mpmapsOld,
+		StringArena& arena) {
+	MapRecord record;
+	record.section = mapSection;
+	record.keys.reserve(24);
+	auto set = [&](std::string_view key, std::string_view value) {
+		record.keys.emplace_back(key, value);
+	};
+	auto note = [&](std::string_view missing) {
+		record.notes.push_back(arena.concat({ "; ", mapSection, " missing ", missing }));
+	};
+	// everything read from the old MPMaps.ini goes through these two, so lookups can be counted
+	auto old = [&](std::string_view key) {
+		++record.lookups;
+		return mpmapsOld.get(mapSection, key);
+	};
+	auto fallback = [&](std::string_view key) {
+		++record.fallbacks;
+		return old(key);
+	};
+
+	// write map name
+	set("Description", mapTitle);
+
+	// write author, prioritize old MPMaps for this one so maps don't need authors updated individually
+	std::string_view mapAuthor = old("Author");
+	if (mapAuthor == NULLSTR) {
+		// author not in old MPMaps, check map
+		mapAuthor = map.author;
+		if (mapAuthor == NULLSTR) {
+			// author not in old MPMaps, set defaut and make note
+			note("Author, set to \"Unknown Author\"");
+			mapAuthor = "Unknown Author";
+		}
+	}
+	set("Author", mapAuthor);
+
+	// write briefing if we can find it
+	std::string_view mapBrief = map.briefing;
+	if (mapBrief == NULLSTR || match_bad_briefing(mapBrief)) // valid briefing not in map, check old MPMaps
+		mapBrief = fallback("Briefing");
+	if (mapBrief != NULLSTR)
+		set("Briefing", mapBrief);
+
+	// write gamemodes, prioritize old MPMaps for this one 'cause lots of maps don't have the correct gamemodes set
+	std::string_view mapModes = old("GameModes");
+	if (mapModes == NULLSTR) // gamemodes not found in old MPMapsn check map
+		mapModes = map.gameMode;
+	if (mapModes == NULLSTR) { // gamemodes not found in map, set default and make note
+		note("GameModes, set to \"Battle\"");
+		mapModes = "Battle";
+	}
+	// when writing, replace "standard" with "battle", then capitalize each word
+	set("GameModes", game_modes_title(mapModes, arena));
+
+	// write coop info if map is coop, check map and MPMaps for IsCoopMission
+	std::string_view iniCoopVal = old("IsCoopMission");
+	std::vector<int> coopEnemyWaypnts; // we need a list of waypoints the player can't choose when we write starting waypoints
+	if (str_iequals(map.isCoopMission, "yes") || str_iequals(map.isCoopMission, "true")
+			|| str_iequals(iniCoopVal, "yes") || str_iequals(iniCoopVal, "true")) {
+		// duh
+		set("IsCoopMission", "yes");
+
+		// write sides and colors player is now allowed to choose
+		for (auto [bannedKey, mapBannedItems] : { std::pair<std::string_view, std::string_view>("DisallowedPlayerSides", map.disallowedPlayerSides),
+				std::pair<std::string_view, std::string_view>("DisallowedPlayerColors", map.disallowedPlayerColors) }) {
+			if (mapBannedItems == NULLSTR)
+				mapBannedItems = fallback(bannedKey);
+			if (mapBannedItems == NULLSTR) {
+				note(bannedKey);
+			}
+			else {
+				set(bannedKey, mapBannedItems);
+			}
+		}
+
+		// write enemy house info
+		size_t enemyHouseNum = 0;
+		bool useMP = false;
+		auto mapEnemyHouseN = [&](size_t n) {
+			return (n < map.enemyHouses.size()) ? std::string_view(map.enemyHouses[n]) : std::string_view(NULLSTR);
+		};
+		std::string_view mapEnemyHouse = mapEnemyHouseN(enemyHouseNum);
+		if (!match_enemy_house(mapEnemyHouse)) {
+			useMP = true;
+			mapEnemyHouse = fallback(enemyHouseKeys[enemyHouseNum]);
+		}
+		if (!match_enemy_house(mapEnemyHouse)) {
+			note("EnemyHouse entries (this has affected Waypoint entires as well)");
+		}
+		else {
+			while (enemyHouseNum <= 8 && mapEnemyHouse != NULLSTR) {
+				// strip comment from mapEnemyHouse if there is one,
+				// we need the last character to be the waypoint for the enemy house
+				std::string_view mapEnemyHouseStripped = strip_enemy_house(mapEnemyHouse);
+				// last character of mapEnemyHouseStripped is the waypoint for the enemy house
+				coopEnemyWaypnts.push_back(mapEnemyHouseStripped[mapEnemyHouseStripped.size() - 1] - '0');
+				set(enemyHouseKeys[enemyHouseNum++], mapEnemyHouse);
+				if (enemyHouseNum > 8)
+					break;
+				mapEnemyHouse = (useMP) ? fallback(enemyHouseKeys[enemyHouseNum]) : mapEnemyHouseN(enemyHouseNum);
+			}
+		}
+	}
+
+	// write min/max players, EnforceMaxPlayers and starting waypoints, base on coop info if map is coop
+	size_t itterWaypnt = 0;
+	for (; itterWaypnt < map.waypoints.size(); ++itterWaypnt) {
+		// only write if this waypoint doesn't belong to an enemy in coop
+		if (std::find(coopEnemyWaypnts.begin(), coopEnemyWaypnts.end(), itterWaypnt) == coopEnemyWaypnts.end())
+			set(waypointKeys[itterWaypnt], map.waypoints[itterWaypnt]);
+	}
+	set("MinPlayers", "2");
+	set("MaxPlayers", arena.number(itterWaypnt - coopEnemyWaypnts.size()));
+	set("EnforceMaxPlayers", "True");
+
+	// get ForcedOptions and ForcedSpawnIniOptions from map,
+	// write it as ForcedOptions-mapname or ForcedSpawnIniOptions-mapname in MPMaps
+	for (auto [forcedKey, forcedEntries] : { std::pair(std::string_view("ForcedOptions"), &map.forcedOptions),
+			std::pair(std::string_view("ForcedSpawnIniOptions"), &map.forcedSpawnIniOptions) }) {
+		if (!forcedEntries->empty()) {
+			std::string_view forcedOptionsName = arena.concat({ forcedKey, "-", mapSection });
+			set(forcedKey, forcedOptionsName);
+			record.sections.emplace_back(forcedOptionsName, forcedEntries);
+		}
+	}
+
+	// write map sizes and preview size
+	set("Size", map.size);
+	set("LocalSize", map.localSize);
+	if (map.hasPreview)
+		set("PreviewSize", arena.concat({ arena.number(map.previewSize.first), ",", arena.number(map.previewSize.second) }));
+	else // couldn't find png preview, make note
+		note("PreviewSize");
+	return record;
+}
+
+/**
+ * Add a map's entries to MPMaps.ini.
+ *
+ * @param mpmaps MPMaps.ini being built.
+ * @param record entries for the map.
+ * @param multiMapsIndex index of the map in [MultiMaps].
+ */
+inline void write_map_record(IniWriter& mpmaps, const MapRecord& record, int multiMapsIndex) {
+	char index[16];
+	std::to_chars_result r = std::to_chars(index, index + sizeof(index), multiMapsIndex);
+	mpmaps.set("MultiMaps", std::string_view(index, size_t(r.ptr - index)), record.section);
+	for (const auto& [key, value] : record.keys)
+		mpmaps.set(record.section, key, value);
+	for (const auto& [name, entries] : record.sections)
+		mpmaps.set_section(name, *entries);
+}
+
+/**
+ * Every map in the tree in the order it was found, with everything read from each.
+ */
+struct MapSet {
+	std::string rootPrefix; // CnCNet path followed by a separator, so root + key is the full path
+	std::vector<std::string> keys; // paths of the maps relative to CnCNet
+	std::vector<MapCache::Entry> entries;
+	std::vector<char> previewStale; // maps whose preview size still has to be read
+	std::vector<char> previewEmbedded; // maps whose preview was filled in from the map itself, which is never cached
+	ScanStats stats;
+	size_t reused = 0; // maps taken from the cache instead of being read
+	size_t shared = 0; // maps with the same content as a map already read under another path
+	size_t previewsRead = 0; // previews whose size was read
+};
+
+/**
+ * Read every map in an inventory, spread across the thread pool. Previews are
+ * left for read_previews.
+ *
+ * @param pool threads to read maps on.
+ * @param inventory maps and previews in the tree.
+ * @param cncnetPath path to CnCNet, which the inventory's paths are relative to.
+ * @param cache data from the last run, empty to read every map.
+ * @param shared maps already read, by content, maps read here are added to it.
+ * @param progress called with the number of maps read so far after each one, one call at a time.
+ * @param stats stats to add the time spent on each map to, nullptr to not time them.
+ * @return every map and what was read from it.
+ */
+inline MapSet read_maps(ThreadPool& pool, const FileInventory& inventory, const std::filesystem::path& cncnetPath,
+		const MapCache& cache, SharedMaps& shared, const std::function<void(size_t)>& progress = nullptr, RunStats* stats = nullptr) {
+	MapSet maps;
+	maps.rootPrefix = root_prefix(cncnetPath);
+	const std::vector<uint32_t>& mapFiles = inventory.maps();
+	for (uint32_t f : mapFiles)
+		maps.keys.emplace_back(inventory.path(f));
+	maps.entries.resize(maps.keys.size());
+	maps.previewStale.resize(maps.keys.size());
+	for (uint32_t f : mapFiles)
+		shared.count_size(inventory.file(f).stamp.size);
+	if (stats)
+		stats->mapMs.assign(maps.keys.size(), 0);
+
+	std::vector<ScanStats> statsPerThread(pool.size()); // bytes read and skipped in maps
+	std::mutex progressLock;
+	size_t mapsRead = 0;
+	pool.parallel_for(maps.keys.size(), [&](size_t i, size_t worker) {
+		bool reused, previewStale, duplicate;
+		RunStats::Clock::time_point start;
+		if (stats)
+			start = RunStats::Clock::now();
+		maps.entries[i] = read_map_cached(cache, maps.keys[i], cncnetPath / maps.keys[i], inventory.file(mapFiles[i]).stamp,
+			inventory.preview_stamp(mapFiles[i]), shared, statsPerThread[worker], reused, previewStale, duplicate);
+		maps.previewStale[i] = previewStale;
+		if (stats)
+			stats->mapMs[i] = RunStats::ms_since(start);
+		std::lock_guard<std::mutex> l(progressLock);
+		++mapsRead;
+		maps.reused += reused;
+		maps.shared += duplicate;
+		if (progress)
+			progress(mapsRead);
+	});
+	for (const ScanStats& st : statsPerThread)
+		maps.stats += st;
+	return maps;
+}
+
+/**
+ * One map tree of a multi-tree run.
+ */
+struct MapTree {
+	std::filesystem::path root; // what the inventory's paths are relative to
+	const FileInventory* inventory;
+};
+
+/**
+ * Read every map of several trees in a single loop, so the pool is kept busy
+ * until the last map of the last tree rather than running dry at the end of
+ * each tree. Maps with the same content are only scanned once. Previews are
+ * left for read_previews.
+ *
+ * @param pool threads to read maps on.
+ * @param trees trees to read.
+ * @param shared maps already read, by content.
+ * @return every map of each tree, in the order of the trees.
+ */
+inline std::vector<MapSet> read_map_trees(ThreadPool& pool, const std::vector<MapTree>& trees, SharedMaps& shared) {
+	std::vector<MapSet> sets(trees.size());
+	std::vector<std::pair<size_t, size_t>> work; // tree and map index of every map
+	for (size_t t = 0; t < trees.size(); ++t) {
+		MapSet& maps = sets[t];
+		maps.rootPrefix = root_prefix(trees[t].root);
+		for (uint32_t f : trees[t].inventory->maps()) {
+			maps.keys.emplace_back(trees[t].inventory->path(f));
+			shared.count_size(trees[t].inventory->file(f).stamp.size);
+		}
+		maps.entries.resize(maps.keys.size());
+		maps.previewStale.assign(maps.keys.size(), true);
+		for (size_t i = 0; i < maps.keys.size(); ++i)
+			work.emplace_back(t, i);
+	}
+
+	std::vector<std::vector<ScanStats>> statsPerThread(trees.size(), std::vector<ScanStats>(pool.size()));
+	std::vector<char> duplicates(work.size());
+	pool.parallel_for(work.size(), [&](size_t w, size_t worker) {
+		auto [t, i] = work[w];
+		const FileInventory& inventory = *trees[t].inventory;
+		uint32_t f = inventory.maps()[i];
+		MapCache::Entry& e = sets[t].entries[i];
+		e.map = inventory.file(f).stamp;
+		e.preview = inventory.preview_stamp(f);
+
+		bool duplicate;
+		e.data = read_map_shared(trees[t].root / sets[t].keys[i], shared, statsPerThread[t][worker], e.hash, duplicate);
+		duplicates[w] = duplicate;
+	});
+	for (size_t w = 0; w < work.size(); ++w)
+		sets[work[w].first].shared += duplicates[w];
+	for (size_t t = 0; t < trees.size(); ++t)
+		for (const ScanStats& st : statsPerThread[t])
+			sets[t].stats += st;
+	return sets;
+}
+
+/**
+ * Read the size of every preview which isn't known yet.
+ *
+ * @param pool threads to read previews on.
+ * @param maps maps to read the previews of.
+ * @param cncnetPath path to CnCNet.
+ */
+inline void read_previews(ThreadPool& pool, MapSet& maps, const std::filesystem::path& cncnetPath) {
+	for (size_t i = 0; i < maps.keys.size(); ++i)
+		maps.previewsRead += maps.previewStale[i] && maps.entries[i].preview != FileStamp();
+	pool.parallel_for(maps.keys.size(), [&](size_t i, size_t) {
+		if (!maps.previewStale[i])
+			return;
+		MapCache::Entry& e = maps.entries[i];
+		e.data.hasPreview = false;
+		if (e.preview != FileStamp()) // no need to look for what the inventory didn't find
+			read_preview_size(e.data, std::filesystem::path(cncnetPath / maps.keys[i]).replace_extension(".png"));
+		maps.previewStale[i] = false;
+	});
+}
+
+/**
+ * What to do for maps without a PNG preview.
+ */
+enum class EmbeddedPreviews {
+	ignore,  // leave a note that PreviewSize is missing
+	size,    // take PreviewSize from the map's own [Preview]
+	extract, // also unpack the map's [PreviewPack] into a PNG next to it
+};
+
+/**
+ * Fill in the preview of every map without a PNG from the preview embedded in
+ * the map itself. Only those maps are read again, and only up to their preview.
+ * A PNG which is there but unreadable is left alone, along with its map.
+ *
+ * @param pool threads to read maps on.
+ * @param maps maps to fill in, after read_previews.
+ * @param cncnetPath path to CnCNet.
+ * @param mode whether to take only the size or write PNGs as well.
+ * @return number of maps whose preview was filled in.
+ */
+inline size_t read_embedded_previews(ThreadPool& pool, MapSet& maps, const std::filesystem::path& cncnetPath, EmbeddedPreviews mode) {
+	if (mode == EmbeddedPreviews::ignore)
+		return 0;
+	std::vector<size_t> missing;
+	for (size_t i = 0; i < maps.keys.size(); ++i)
+		if (!maps.entries[i].data.hasPreview && maps.entries[i].preview == FileStamp())
+			missing.push_back(i);
+	std::vector<char> found(missing.size());
+	maps.previewEmbedded.resize(maps.keys.size());
+	pool.parallel_for(missing.size(), [&](size_t m, size_t) {
+		size_t i = missing[m];
+		std::filesystem::path mapPath = cncnetPath / maps.keys[i];
+		ScanStats scanned; // the map was counted when it was first read
+		IniDocument mapIni = scan_map(mapPath, (mode == EmbeddedPreviews::extract) ? previewSections : previewSizeSections, scanned);
+		std::pair<int, int> size;
+		if (!embedded_preview_size(mapIni, size))
+			return;
+		if (mode == EmbeddedPreviews::extract) {
+			std::vector<uint8_t> pixels;
+			if (!unpack_preview(mapIni, size.first, size.second, pixels)
+					|| !save_png(std::filesystem::path(mapPath).replace_extension(".png"), size.first, size.second, pixels))
+				return;
+		}
+		MapData& data = maps.entries[i].data;
+		data.previewSize = size;
+		data.hasPreview = true;
+		maps.previewEmbedded[i] = true;
+		found[m] = true;
+	});
+	return size_t(std::count(found.begin(), found.end(), true));
+}
+
+/**
+ * Replace everything in a cache with the maps of a set, as they were read from
+ * the files. Previews filled in by read_embedded_previews are left out, so a
+ * later run without --embedded-previews doesn't take them from the cache.
+ *
+ * @param cache cache to fill.
+ * @param maps maps to put in it.
+ */
+inline void cache_maps(MapCache& cache, const MapSet& maps) {
+	cache.clear();
+	for (size_t i = 0; i < maps.keys.size(); ++i) {
+		if (i < maps.previewEmbedded.size() && maps.previewEmbedded[i]) {
+			MapCache::Entry e = maps.entries[i];
+			e.data.hasPreview = false;
+			e.data.previewSize = std::pair<int, int>();
+			cache.set(maps.keys[i], e);
+			continue;
+		}
+		cache.set(maps.keys[i], maps.entries[i]);
+	}
+}
+
+/**
+ * Group maps with identical content by the size and hash they were read with.
+ *
+ * @param maps maps to group.
+ * @return groups of two or more indexes into 'maps', in the order their first map was found.
+ */
+inline std::vector<std::vector<size_t>> duplicate_maps(const MapSet& maps) {
+	std::map<std::pair<uint64_t, uint64_t>, size_t> groupOf; // size and hash to index in 'groups'
+	std::vector<std::vector<size_t>> groups;
+	for (size_t i = 0; i < maps.entries.size(); ++i) {
+		uint64_t hash = maps.entries[i].hash;
+		if (hash == 0) // never hashed, nothing to compare it with
+			continue;
+		auto [it, added] = groupOf.try_emplace(std::make_pair(maps.entries[i].map.size, hash), groups.size());
+		if (added)
+			groups.emplace_back();
+		groups[it->second].push_back(i);
+	}
+	groups.erase(std::remove_if(groups.begin(), groups.end(), [](const std::vector<size_t>& g) { return g.size() < 2; }), groups.end());
+	return groups;
+}
+
+/**
+ * Take every map from a snapshot instead of reading the tree.
+ *
+ * @param snapshot snapshot to take the maps from.
+ * @return every map in the snapshot.
+ */
+inline MapSet snapshot_maps(const SnapshotReader& snapshot) {
+	MapSet maps;
+	maps.rootPrefix = snapshot.root();
+	for (size_t i = 0; i < snapshot.map_count(); ++i) {
+		maps.keys.emplace_back(snapshot.map_path(i));
+		maps.entries.emplace_back().data = snapshot.map_data(i);
+	}
+	maps.previewStale.resize(maps.keys.size());
+	return maps;
+}
+
+/**
+ * Map with a valid name, sorted by its title followed by its full path, the
+ * title starting with the player count. The first 8 bytes of that key are
+ * kept as a number so most comparisons never touch the string.
+ */
+struct NamedMap {
+	uint64_t prefix = 0; // first bytes of the key, big-endian so it sorts like the string
+	std::string_view key; // title followed by full path, in case maps have the same name
+	uint32_t titleSize = 0; // length of the title at the start of the key
+	uint32_t index = 0; // index of the map in its MapSet
+
+	NamedMap(std::string_view key, size_t titleSize, size_t index) : key(key), titleSize(uint32_t(titleSize)), index(uint32_t(index)) {
+		for (size_t i = 0; i < sizeof(prefix); ++i)
+			prefix = (prefix << 8) | ((i < key.size()) ? (unsigned char)key[i] : 0);
+	}
+
+	std::string_view title() const {
+		return key.substr(0, titleSize);
+	}
+
+	bool operator<(const NamedMap& other) const {
+		if (prefix != other.prefix)
+			return prefix < other.prefix;
+		return key < other.key;
+	}
+};
+
+/**
+ * Maps with a valid name, in the order they go in [MultiMaps].
+ */
+struct MapNames {
+	std::vector<NamedMap> ordered;
+	std::vector<std::string> missing; // maps without a valid name, as written to map_names_missing.txt
+	size_t lookups = 0; // names looked up in the old MPMaps.ini because the map's wasn't valid
+	StringArena keys; // what the keys in 'ordered' point at
+};
+
+/**
+ * Find a valid name for every map, from the map itself or from the old MPMaps.ini,
+ * and sort them by player number, followed by map title.
+ *
+ * @param pool threads to sort the maps on.
+ * @param maps maps to name.
+ * @param mpmapsOld the old MPMaps.ini.
+ * @return maps sorted by name, and the ones without a valid name.
+ */
+inline MapNames name_maps(ThreadPool& pool, const MapSet& maps, const IniDocument& mpmapsOld) {
+	MapNames names;
+	names.ordered.reserve(maps.keys.size());
+	for (size_t i = 0; i < maps.keys.size(); ++i) {
+		// start looking for the name in the map itself
+		const std::string& mapTitle = maps.entries[i].data.name;
+		if (match_map_title(mapTitle)) {
+			names.ordered.emplace_back(names.keys.concat({ mapTitle, maps.rootPrefix, maps.keys[i] }), mapTitle.size(), i);
+			continue;
+		}
+
+		// valid name not found in map, fall back on old MPMaps.ini
+		// remove parts of path not included in MPMaps section name
+		std::string mapSection = map_section(maps.keys[i]);
+		// get new map name and validate
+		std::string mapTitleMP(mpmapsOld.get(mapSection, "Description"));
+		++names.lookups;
+		if (match_map_title(mapTitleMP)) {
+			names.ordered.emplace_back(names.keys.concat({ mapTitleMP, maps.rootPrefix, maps.keys[i] }), mapTitleMP.size(), i);
+			continue;
+		}
+
+		// valid name not found in MPMaps.ini, push to missing name vector
+		names.missing.push_back(
+			mapSection + "\nname in map was " + ((mapTitle == NULLSTR) ? "not found" : mapTitle) +
+			", name in MPMaps.ini was " + ((mapTitleMP == NULLSTR) ? "not found" : mapTitleMP) + '\n');
+	}
+	parallel_sort(pool, names.ordered.begin(), names.ordered.end(), std::less<NamedMap>());
+	return names;
+}
+
+/**
+ * Add every named map to MPMaps.ini, followed by comments on any data which was missing.
+ *
+ * @param mpmaps MPMaps.ini being built, seeded with MPMapsBase.ini.
+ * @param pool threads to work out the maps' entries on.
+ * @param maps maps to add.
+ * @param names maps to add, in order.
+ * @param mpmapsOld the old MPMaps.ini.
+ * @param stats stats to add lookups and the time spent on each map to, nullptr to count nothing.
+ * @return number of notes on missing data.
+ */
+inline size_t build_mpmaps(IniWriter& mpmaps, ThreadPool& pool, const MapSet& maps, const MapNames& names, const IniDocument& mpmapsOld,
+		RunStats* stats = nullptr) {
+	// work out each map's entries in parallel, then add them in order so the output doesn't depend on thread timing
+	std::vector<MapRecord> records(names.ordered.size());
+	std::vector<StringArena> arenas(pool.size()); // whatever the records point at, until they're written
+	pool.parallel_for(names.ordered.size(), [&](size_t i, size_t worker) {
+		size_t mapIndex = names.ordered[i].index;
+		RunStats::Clock::time_point start;
+		if (stats)
+			start = RunStats::Clock::now();
+		std::string_view mapSection = map_section(maps.keys[mapIndex], arenas[worker]);
+		records[i] = build_map_record(mapSection, names.ordered[i].title(), maps.entries[mapIndex].data, mpmapsOld, arenas[worker]);
+		if (stats && mapIndex < stats->mapMs.size()) // each map is built once, so no two threads add to the same one
+			stats->mapMs[mapIndex] += RunStats::ms_since(start);
+	});
+
+	// go through each map, add to [MultiMaps] and write its individual section
+	std::vector<std::string_view> notes; // whatever was found missing, appended to the end of MPMaps as comments
+	int multiMapsIndex = 0;
+	for (const MapRecord& record : records) {
+		write_map_record(mpmaps, record, multiMapsIndex++);
+		notes.insert(notes.end(), record.notes.begin(), record.notes.end());
+		if (stats) {
+			stats->lookups += record.lookups;
+			stats->fallbacks += record.fallbacks;
+		}
+	}
+	for (std::string_view s : notes)
+		mpmaps.append_line(s);
+	return notes.size();
+}
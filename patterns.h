@@ -0,0 +1,102 @@
+/**
+ * @file patterns.h
+ * @brief Matchers for the few fixed patterns map values are checked against.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <string_view>
+
+/*
+ * Each matcher does exactly what std::regex_match does with the ECMAScript
+ * pattern next to it, without building an automaton or allocating. In those
+ * patterns \d is 0-9, \s is any of " \t\n\v\f\r" and '.' is anything but
+ * '\n' and '\r'.
+ */
+
+inline bool pattern_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+inline bool pattern_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Check that a string has no line breaks, what ".*" matches.
+ *
+ * @param s string to check.
+ * @return true if '.' would match every character.
+ */
+inline bool pattern_single_line(std::string_view s) {
+	return s.find_first_of("\n\r") == std::string_view::npos;
+}
+
+/**
+ * Check for a valid map name, "^\[\d\] \S.+$", e.g. "[4] Little Big Lake".
+ *
+ * @param s name to check.
+ * @return true if the name is valid.
+ */
+inline bool match_map_title(std::string_view s) {
+	return s.size() >= 6 && s[0] == '[' && pattern_digit(s[1]) && s[2] == ']' && s[3] == ' '
+		&& !pattern_space(s[4]) && pattern_single_line(s.substr(5));
+}
+
+/**
+ * Check for a placeholder briefing, "^Brief:(ALL|TRN)\d{2}(md)?$", e.g. "Brief:ALL01"
+ * (a reference to a campaign briefing string the client can't show).
+ *
+ * @param s briefing to check.
+ * @return true if the briefing is a placeholder.
+ */
+inline bool match_bad_briefing(std::string_view s) {
+	constexpr std::string_view prefix = "Brief:";
+	if ((s.size() != 11 && s.size() != 13) || s.substr(0, prefix.size()) != prefix)
+		return false;
+	std::string_view campaign = s.substr(6, 3);
+	return (campaign == "ALL" || campaign == "TRN") && pattern_digit(s[9]) && pattern_digit(s[10])
+		&& (s.size() == 11 || s.substr(11) == "md");
+}
+
+/**
+ * Check for a valid EnemyHouse value, "^(\d+,\d+,\d+)\s*;?.*$", e.g. "2,6,4 ;Soviet, red, waypoint 4".
+ *
+ * @param s value to check.
+ * @param fields set to the "side,color,waypoint" part of the value if it's valid.
+ * @return true if the value is valid.
+ */
+inline bool match_enemy_house(std::string_view s, std::string_view* fields = nullptr) {
+	size_t pos = 0;
+	for (int field = 0; field < 3; ++field) {
+		if (field > 0 && (pos >= s.size() || s[pos++] != ','))
+			return false;
+		size_t start = pos;
+		while (pos < s.size() && pattern_digit(s[pos]))
+			++pos;
+		if (pos == start)
+			return false;
+	}
+	size_t end = pos;
+	// whitespace can include line breaks, after it the ";?.*" can't
+	while (pos < s.size() && pattern_space(s[pos]))
+		++pos;
+	if (!pattern_single_line(s.substr(pos)))
+		return false;
+	if (fields != nullptr)
+		*fields = s.substr(0, end);
+	return true;
+}
+
+/**
+ * Strip anything after the fields of an EnemyHouse value, what
+ * std::regex_replace(s, enemyHousePattern, "$1") does.
+ *
+ * @param s value to strip.
+ * @return "side,color,waypoint" part of the value, or the whole value if it isn't valid.
+ */
+inline std::string_view strip_enemy_house(std::string_view s) {
+	std::string_view fields;
+	return match_enemy_house(s, &fields) ? fields : s;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file platform.h
+ * @brief The few things we need from the OS, for Windows and POSIX.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Get the location of this program.
+ *
+ * @return path to the directory containing this program.
+ */
+inline std::filesystem::path program_path() {
+#ifdef _WIN32
+	wchar_t result[MAX_PATH];
+	return std::filesystem::path(std::wstring(result, GetModuleFileNameW(NULL, result, MAX_PATH))).remove_filename();
+#else
+	std::error_code ec;
+	std::filesystem::path exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+	if (ec) // no procfs, settle for the working directory
+		return std::filesystem::current_path();
+	return exe.remove_filename();
+#endif
+}
+
+/**
+ * Get the most memory this process has had resident at once.
+ *
+ * @return peak resident memory in bytes, 0 if the OS won't say.
+ */
+inline uint64_t peak_memory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return uint64_t(usage.ru_maxrss); // already in bytes
+#else
+	return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/**
+ * Read a big endian 32-bit integer, the byte order PNG uses.
+ *
+ * @param p pointer to the 4 bytes to read.
+ * @return integer read.
+ */
+inline uint32_t read_be32(const unsigned char* p) {
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/**
+ * Read part of a file without opening a stream for it.
+ *
+ * @param path path to the file.
+ * @param offset byte to start reading from.
+ * @param buf buffer to read into.
+ * @param len number of bytes to read.
+ * @return number of bytes read, which is less than 'len' if the file is shorter or can't be read.
+ */
+inline size_t read_file_at(const std::filesystem::path& path, uint64_t offset, void* buf, size_t len) {
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+	OVERLAPPED at = {};
+	at.Offset = DWORD(offset);
+	at.OffsetHigh = DWORD(offset >> 32);
+	DWORD n = 0;
+	if (!ReadFile(file, buf, DWORD(len), &n, &at))
+		n = 0;
+	CloseHandle(file);
+	return n;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+	ssize_t n = ::pread(fd, buf, len, off_t(offset));
+	::close(fd);
+	return (n < 0) ? 0 : size_t(n);
+#endif
+}
+
+/**
+ * Read-only memory mapping of a whole file, so it can be scanned in place
+ * without copying it into buffers first. Pages are only read from disk when
+ * they're touched, so whatever isn't looked at is never read.
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+
+	/**
+	 * Map a file.
+	 *
+	 * @param path path to the file.
+	 */
+	explicit MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping != NULL) {
+				addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping); // the view keeps the mapping alive
+			}
+			if (addr != nullptr)
+				length = size_t(size.QuadPart);
+		}
+		opened = true;
+		CloseHandle(file);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				addr = p;
+				length = size_t(st.st_size);
+				::madvise(addr, length, MADV_SEQUENTIAL);
+			}
+		}
+		opened = true;
+		::close(fd); // the mapping keeps the file alive
+#endif
+	}
+
+	~MappedFile() {
+		if (addr == nullptr)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(addr);
+#else
+		::munmap(addr, length);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept : addr(other.addr), length(other.length), opened(other.opened) {
+		other.addr = nullptr;
+		other.length = 0;
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		std::swap(addr, other.addr);
+		std::swap(length, other.length);
+		std::swap(opened, other.opened);
+		return *this;
+	}
+
+	/**
+	 * Check whether the file was opened. An empty file is opened but has nothing mapped.
+	 *
+	 * @return true if the file was opened, false if not.
+	 */
+	bool is_open() const {
+		return opened;
+	}
+
+	std::string_view view() const {
+		return std::string_view((const char*)addr, length);
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+private:
+	void* addr = nullptr;
+	size_t length = 0;
+	bool opened = false;
+};
@@ -0,0 +1,461 @@
+/**
+ * @file previewpack.h
+ * @brief Decoding the preview embedded in a map and saving it as a PNG.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "inidocument.h"
+
+// base64 is decoded a register at a time wherever the compiler targets SSE2 or AVX2,
+// SSE2 is always there on x64, AVX2 only when building with -mavx2 or /arch:AVX2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define YRMU_BASE64_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YRMU_BASE64_SSE2
+#endif
+
+// sections of a map the embedded preview is read from
+const std::vector<std::string_view> previewSections = { "Preview", "PreviewPack" };
+const std::vector<std::string_view> previewSizeSections = { "Preview" };
+
+// previews are the size of the map in cells, nothing real comes close to this
+const int previewMaxSide = 4096;
+
+/**
+ * Value of every base64 character, 0xFF for anything else.
+ *
+ * @return table of values by character.
+ */
+inline const std::array<uint8_t, 256>& base64_values() {
+	static const std::array<uint8_t, 256> values = [] {
+		std::array<uint8_t, 256> v;
+		v.fill(0xFF);
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		for (uint8_t i = 0; i < 64; ++i)
+			v[(unsigned char)alphabet[i]] = i;
+		return v;
+	}();
+	return values;
+}
+
+#ifdef YRMU_BASE64_SSE2
+/**
+ * Decode 16 base64 characters into 12 bytes.
+ *
+ * @param in characters to decode.
+ * @param out where to write the bytes.
+ * @return false if any of the characters isn't base64, nothing is written then.
+ */
+inline bool base64_block_sse2(const char* in, uint8_t* out) {
+	__m128i c = _mm_loadu_si128((const __m128i*)in);
+	auto range = [&](char lo, char hi) {
+		return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(char(lo - 1))), _mm_cmplt_epi8(c, _mm_set1_epi8(char(hi + 1))));
+	};
+	__m128i upper = range('A', 'Z');
+	__m128i lower = range('a', 'z');
+	__m128i digit = range('0', '9');
+	__m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+	__m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+	if (_mm_movemask_epi8(valid) != 0xFFFF) // padding or a damaged line, left for the scalar loop
+		return false;
+	// each range is a fixed distance from its values
+	__m128i offset = _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)), _mm_and_si128(lower, _mm_set1_epi8(-71))),
+		_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+			_mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(19)), _mm_and_si128(slash, _mm_set1_epi8(16)))));
+	__m128i v = _mm_add_epi8(c, offset);
+	// join pairs of 6-bit values into 12 bits, then pairs of those into the 24 bits of each group of four
+	__m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x00FF)), 6), _mm_srli_epi16(v, 8));
+	__m128i groups = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)), 12), _mm_srli_epi32(pairs, 16));
+	alignas(16) uint32_t g[4];
+	_mm_store_si128((__m128i*)g, groups);
+	for (int i = 0; i < 4; ++i) {
+		out[i * 3] = uint8_t(g[i] >> 16);
+		out[i * 3 + 1] = uint8_t(g[i] >> 8);
+		out[i * 3 + 2] = uint8_t(g[i]);
+	}
+	return true;
+}
+#endif
+
+#ifdef YRMU_BASE64_AVX2
+/**
+ * Decode 32 base64 characters into 24 bytes, the same way as base64_block_sse2.
+ *
+ * @param in characters to decode.
+ * @param out where to write the bytes.
+ * @return false if any of the characters isn't base64, nothing is written then.
+ */
+inline bool base64_block_avx2(const char* in, uint8_t* out) {
+	__m256i c = _mm256_loadu_si256((const __m256i*)in);
+	auto range = [&](char lo, char hi) {
+		return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(char(lo - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8(char(hi + 1)), c));
+	};
+	__m256i upper = range('A', 'Z');
+	__m256i lower = range('a', 'z');
+	__m256i digit = range('0', '9');
+	__m256i plus = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+'));
+	__m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+	__m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+	if (uint32_t(_mm256_movemask_epi8(valid)) != 0xFFFFFFFFu)
+		return false;
+	__m256i offset = _mm256_or_si256(
+		_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)), _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+		_mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(4)),
+			_mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(19)), _mm256_and_si256(slash, _mm256_set1_epi8(16)))));
+	__m256i v = _mm256_add_epi8(c, offset);
+	__m256i pairs = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(v, _mm256_set1_epi16(0x00FF)), 6), _mm256_srli_epi16(v, 8));
+	__m256i groups = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(pairs, _mm256_set1_epi32(0xFFFF)), 12), _mm256_srli_epi32(pairs, 16));
+	alignas(32) uint32_t g[8];
+	_mm256_store_si256((__m256i*)g, groups);
+	for (int i = 0; i < 8; ++i) {
+		out[i * 3] = uint8_t(g[i] >> 16);
+		out[i * 3 + 1] = uint8_t(g[i] >> 8);
+		out[i * 3 + 2] = uint8_t(g[i]);
+	}
+	return true;
+}
+#endif
+
+/**
+ * Decode base64, up to the padding if there is any.
+ *
+ * @param in base64 text, without line breaks.
+ * @param out decoded bytes are appended to this.
+ * @return false if there was anything other than base64 before the padding, nothing is appended then.
+ */
+inline bool base64_decode(std::string_view in, std::vector<uint8_t>& out) {
+	size_t start = out.size();
+	out.resize(start + in.size() / 4 * 3 + 3);
+	uint8_t* o = out.data() + start;
+	size_t i = 0;
+#ifdef YRMU_BASE64_AVX2
+	for (; i + 32 <= in.size() && base64_block_avx2(in.data() + i, o); i += 32, o += 24) {}
+#endif
+#ifdef YRMU_BASE64_SSE2
+	for (; i + 16 <= in.size() && base64_block_sse2(in.data() + i, o); i += 16, o += 12) {}
+#endif
+	// the tail, and anything the blocks stopped at
+	const std::array<uint8_t, 256>& values = base64_values();
+	uint32_t bits = 0;
+	int count = 0;
+	for (; i < in.size() && in[i] != '='; ++i) {
+		uint8_t v = values[(unsigned char)in[i]];
+		if (v == 0xFF) {
+			out.resize(start);
+			return false;
+		}
+		bits = (bits << 6) | v;
+		if (++count == 4) {
+			*o++ = uint8_t(bits >> 16);
+			*o++ = uint8_t(bits >> 8);
+			*o++ = uint8_t(bits);
+			bits = 0;
+			count = 0;
+		}
+	}
+	if (count == 1) { // six bits can't make a byte
+		out.resize(start);
+		return false;
+	}
+	if (count > 1) {
+		bits <<= 6 * (4 - count);
+		*o++ = uint8_t(bits >> 16);
+		if (count == 3)
+			*o++ = uint8_t(bits >> 8);
+	}
+	out.resize(size_t(o - out.data()));
+	return true;
+}
+
+/**
+ * Decompress LZO1X, which is what the game packs [PreviewPack] with. Every
+ * read and write is checked, so a damaged map can't take us out of either buffer.
+ *
+ * @param in compressed data.
+ * @param inSize size of the compressed data.
+ * @param out buffer to decompress into.
+ * @param outSize size of the buffer.
+ * @param written number of bytes decompressed.
+ * @return true if the data ended where it should, false if it was damaged.
+ */
+inline bool lzo1x_decompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize, size_t& written) {
+	const uint8_t* ip = in;
+	const uint8_t* const ipEnd = in + inSize;
+	uint8_t* op = out;
+	uint8_t* const opEnd = out + outSize;
+	auto need = [&](size_t n) {
+		return size_t(ipEnd - ip) >= n;
+	};
+	auto literals = [&](size_t n) {
+		if (!need(n) || size_t(opEnd - op) < n)
+			return false;
+		std::memcpy(op, ip, n);
+		op += n;
+		ip += n;
+		return true;
+	};
+	// copy from earlier output, a byte at a time when the match overlaps itself to repeat a pattern
+	auto match = [&](size_t distance, size_t n) {
+		if (distance > size_t(op - out) || size_t(opEnd - op) < n)
+			return false;
+		const uint8_t* from = op - distance;
+		if (distance >= n)
+			std::memcpy(op, from, n);
+		else
+			for (size_t k = 0; k < n; ++k)
+				op[k] = from[k];
+		op += n;
+		return true;
+	};
+	// lengths too long for their instruction go on in zero bytes worth 255 each, then a last byte
+	auto extended = [&](size_t base, size_t& n) {
+		n = base;
+		while (need(1) && *ip == 0) {
+			n += 255;
+			++ip;
+		}
+		if (!need(1))
+			return false;
+		n += *ip++;
+		return true;
+	};
+
+	// what an instruction below 16 means depends on what came before it
+	enum { afterMatch, afterRun, afterFewLiterals } state = afterMatch;
+	if (need(1) && *ip > 17) { // the stream may start with a run of literals and no instruction
+		size_t n = size_t(*ip++) - 17;
+		if (!literals(n))
+			return false;
+		state = (n < 4) ? afterFewLiterals : afterRun;
+	}
+	for (;;) {
+		if (!need(1))
+			return false;
+		size_t t = *ip++;
+		size_t distance, n;
+		if (t < 16 && state == afterMatch) { // run of literals
+			if (t == 0 && !extended(15, t))
+				return false;
+			if (!literals(t + 3))
+				return false;
+			state = afterRun;
+			continue;
+		}
+		if (t < 16) { // short match, only allowed right after literals
+			if (!need(1))
+				return false;
+			distance = 1 + (t >> 2) + (size_t(*ip++) << 2);
+			n = 2;
+			if (state == afterRun) {
+				distance += 0x800;
+				n = 3;
+			}
+		}
+		else if (t >= 64) { // match within 2 KB
+			if (!need(1))
+				return false;
+			distance = 1 + ((t >> 2) & 7) + (size_t(*ip++) << 3);
+			n = (t >> 5) + 1;
+		}
+		else if (t >= 32) { // match within 16 KB
+			n = t & 31;
+			if (n == 0 && !extended(31, n))
+				return false;
+			n += 2;
+			if (!need(2))
+				return false;
+			distance = 1 + (ip[0] >> 2) + (size_t(ip[1]) << 6);
+			ip += 2;
+		}
+		else { // match within 48 KB, or the end of the stream
+			n = t & 7;
+			if (n == 0 && !extended(7, n))
+				return false;
+			n += 2;
+			if (!need(2))
+				return false;
+			distance = ((t & 8) << 11) + (ip[0] >> 2) + (size_t(ip[1]) << 6);
+			ip += 2;
+			if (distance == 0) {
+				written = size_t(op - out);
+				return ip == ipEnd;
+			}
+			distance += 0x4000;
+		}
+		if (!match(distance, n))
+			return false;
+		// the low bits of the match's second to last byte are how many literals follow it
+		size_t trailing = ip[-2] & 3;
+		if (trailing == 0) {
+			state = afterMatch;
+			continue;
+		}
+		if (!literals(trailing))
+			return false;
+		state = afterFewLiterals;
+	}
+}
+
+/**
+ * Get the size of the preview embedded in a map, from Size=X,Y,Width,Height in [Preview].
+ *
+ * @param mapIni sections of the map, including [Preview].
+ * @param size width and height of the preview.
+ * @return true if the map has a preview of a sensible size, false if not.
+ */
+inline bool embedded_preview_size(const IniDocument& mapIni, std::pair<int, int>& size) {
+	std::string value(mapIni.get("Preview", "Size"));
+	long parts[4];
+	const char* p = value.c_str();
+	for (long& part : parts) {
+		char* end;
+		part = std::strtol(p, &end, 10);
+		if (end == p)
+			return false;
+		p = (*end == ',') ? end + 1 : end;
+	}
+	if (parts[2] <= 0 || parts[3] <= 0 || parts[2] > previewMaxSide || parts[3] > previewMaxSide)
+		return false;
+	size = std::pair<int, int>(int(parts[2]), int(parts[3]));
+	return true;
+}
+
+/**
+ * Unpack the preview embedded in a map. [PreviewPack] is base64 of blocks
+ * which each start with their packed and unpacked sizes, 16 bits each, and
+ * unpack to 24-bit RGB pixels.
+ *
+ * @param mapIni sections of the map, including [PreviewPack].
+ * @param width width of the preview.
+ * @param height height of the preview.
+ * @param pixels unpacked pixels, row by row.
+ * @return true if the preview unpacked to exactly its size, false if not.
+ */
+inline bool unpack_preview(const IniDocument& mapIni, int width, int height, std::vector<uint8_t>& pixels) {
+	const IniDocument::Section* pack = mapIni.section("PreviewPack");
+	if (pack == nullptr || width <= 0 || height <= 0)
+		return false;
+	std::string text;
+	for (const IniDocument::Entry& e : pack->entries)
+		text += e.value;
+	std::vector<uint8_t> packed;
+	if (!base64_decode(text, packed))
+		return false;
+
+	pixels.resize(size_t(width) * size_t(height) * 3);
+	size_t at = 0, done = 0;
+	while (done < pixels.size()) {
+		if (packed.size() - at < 4)
+			return false;
+		size_t packedSize = packed[at] | (size_t(packed[at + 1]) << 8);
+		size_t unpackedSize = packed[at + 2] | (size_t(packed[at + 3]) << 8);
+		at += 4;
+		if (packedSize > packed.size() - at || unpackedSize > pixels.size() - done)
+			return false;
+		size_t written;
+		if (!lzo1x_decompress(packed.data() + at, packedSize, pixels.data() + done, unpackedSize, written) || written != unpackedSize)
+			return false;
+		at += packedSize;
+		done += unpackedSize;
+	}
+	return true;
+}
+
+/**
+ * Save 24-bit RGB pixels as a PNG. The image data is stored rather than
+ * compressed, so it's quick to write and needs no zlib.
+ *
+ * @param path path to write the PNG to.
+ * @param width width of the image.
+ * @param height height of the image.
+ * @param pixels pixels, row by row.
+ * @return true if the file was written, false if not.
+ */
+inline bool save_png(const std::filesystem::path& path, int width, int height, const std::vector<uint8_t>& pixels) {
+	static const std::array<uint32_t, 256> crcTable = [] {
+		std::array<uint32_t, 256> table;
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+			table[n] = c;
+		}
+		return table;
+	}();
+	auto put32 = [](std::string& s, uint32_t x) {
+		for (int shift = 24; shift >= 0; shift -= 8)
+			s += char(x >> shift);
+	};
+	std::string png("\x89PNG\r\n\x1A\n", 8);
+	auto chunk = [&](const char* type, const std::string& data) {
+		put32(png, uint32_t(data.size()));
+		size_t start = png.size();
+		png += type;
+		png += data;
+		uint32_t crc = 0xFFFFFFFF;
+		for (size_t i = start; i < png.size(); ++i)
+			crc = crcTable[(crc ^ (unsigned char)png[i]) & 0xFF] ^ (crc >> 8);
+		put32(png, ~crc);
+	};
+
+	std::string header;
+	put32(header, uint32_t(width));
+	put32(header, uint32_t(height));
+	header += std::string("\x08\x02\x00\x00\x00", 5); // 8 bits per channel, RGB
+	chunk("IHDR", header);
+
+	// every row starts with filter type 0, the rows then go in a zlib stream of stored deflate blocks
+	size_t rowSize = size_t(width) * 3;
+	std::string raw;
+	raw.reserve((rowSize + 1) * size_t(height));
+	for (int y = 0; y < height; ++y) {
+		raw += '\0';
+		raw.append((const char*)pixels.data() + y * rowSize, rowSize);
+	}
+	std::string zlib("\x78\x01", 2);
+	for (size_t at = 0; at < raw.size(); ) {
+		size_t n = std::min<size_t>(raw.size() - at, 0xFFFF);
+		zlib += char(at + n == raw.size()); // last block flag
+		zlib += char(n & 0xFF);
+		zlib += char(n >> 8);
+		zlib += char(~n & 0xFF);
+		zlib += char((~n >> 8) & 0xFF);
+		zlib.append(raw, at, n);
+		at += n;
+	}
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); ) {
+		// sums can go this long before they have to be reduced
+		for (size_t end = std::min(raw.size(), i + 5552); i < end; ++i) {
+			a += (unsigned char)raw[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	put32(zlib, (b << 16) | a);
+	chunk("IDAT", zlib);
+	chunk("IEND", "");
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(png.data(), png.size());
+	return bool(out);
+}
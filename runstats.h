@@ -0,0 +1,206 @@
+/**
+ * @file runstats.h
+ * @brief Timings and counters collected over a run when --stats is given.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Everything measured over a run. Nothing is measured unless a RunStats is
+ * handed to the pipeline, so a run without --stats doesn't even read the clock.
+ */
+class RunStats {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Phase {
+		std::string name;
+		double ms;
+	};
+
+	struct SlowMap {
+		std::string key; // path of the map relative to CnCNet
+		double ms;
+	};
+
+	std::vector<Phase> phases; // in the order they ran
+	std::vector<double> mapMs; // time spent reading and building each map, by its index in the MapSet
+
+	uint64_t maps = 0;              // maps in the tree
+	uint64_t mapsRead = 0;          // maps actually read, rather than taken from the cache
+	uint64_t mapBytesTotal = 0;     // size of every map read
+	uint64_t mapBytesRead = 0;      // bytes of maps looked at before the scanner stopped
+	uint64_t mapBytesHashed = 0;    // bytes of maps hashed to find copies of them
+	uint64_t mpmapsOldBytes = 0;    // size of the old MPMaps.ini
+	uint64_t previewsRead = 0;      // previews whose size was read
+	uint64_t previewBytesRead = 0;  // bytes read from previews
+	uint64_t lookups = 0;           // keys looked up in the old MPMaps.ini
+	uint64_t fallbacks = 0;         // lookups made because the map didn't have a usable value
+	uint64_t notes = 0;             // notes on missing data written to MPMaps.ini
+	std::vector<SlowMap> slowest;
+	std::vector<std::vector<std::string>> duplicates; // paths of maps with identical content, a group at a time
+
+	/**
+	 * Milliseconds since a point in time.
+	 *
+	 * @param start point to measure from.
+	 * @return milliseconds elapsed.
+	 */
+	static double ms_since(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	/**
+	 * Pick the slowest maps out of mapMs.
+	 *
+	 * @param keys paths of the maps, by the same index as mapMs.
+	 * @param n number of maps to keep.
+	 */
+	void find_slowest(const std::vector<std::string>& keys, size_t n) {
+		std::vector<size_t> order(std::min(keys.size(), mapMs.size()));
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		n = std::min(n, order.size());
+		std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](size_t a, size_t b) {
+			return (mapMs[a] != mapMs[b]) ? mapMs[a] > mapMs[b] : a < b;
+		});
+		slowest.clear();
+		for (size_t i = 0; i < n; ++i)
+			slowest.push_back({ keys[order[i]], mapMs[order[i]] });
+	}
+
+	/**
+	 * Print a summary for the console.
+	 *
+	 * @param out stream to print to.
+	 */
+	void print(std::ostream& out) const {
+		double total = 0;
+		for (const Phase& p : phases)
+			total += p.ms;
+		out << std::fixed << std::setprecision(2);
+		out << "Time spent, " << total << " ms in total:" << std::endl;
+		for (const Phase& p : phases)
+			out << "  " << std::left << std::setw(16) << p.name << std::right << std::setw(10) << p.ms << " ms" << std::endl;
+		out << "Read " << mapsRead << " of " << maps << " maps, looked at " << mapBytesRead / 1024 << " of "
+			<< mapBytesTotal / 1024 << " KB, hashed " << mapBytesHashed / 1024 << " KB to find copies" << std::endl;
+		out << "Read " << mpmapsOldBytes / 1024 << " KB of the old MPMaps.ini and " << previewBytesRead << " bytes of "
+			<< previewsRead << " previews" << std::endl;
+		out << lookups << " lookups in the old MPMaps.ini, " << fallbacks << " of them because a map was missing a value, "
+			<< notes << " notes on missing data" << std::endl;
+		if (!slowest.empty()) {
+			out << "Slowest maps:" << std::endl;
+			for (const SlowMap& m : slowest)
+				out << "  " << std::setw(10) << m.ms << " ms  " << m.key << std::endl;
+		}
+		if (!duplicates.empty()) {
+			out << "Identical maps:" << std::endl;
+			for (const std::vector<std::string>& group : duplicates) {
+				for (size_t i = 0; i < group.size(); ++i)
+					out << (i ? "    " : "  ") << group[i] << std::endl;
+			}
+		}
+		out << std::defaultfloat << std::setprecision(6);
+	}
+
+	/**
+	 * Write everything to a JSON file.
+	 *
+	 * @param path path of the file to write.
+	 * @return true if the file was written, false if not.
+	 */
+	bool save_json(const std::filesystem::path& path) const {
+		std::ofstream out(path, std::ios::binary);
+		if (!out)
+			return false;
+		out << "{\n  \"phases_ms\": {";
+		for (size_t i = 0; i < phases.size(); ++i)
+			out << (i ? ", " : " ") << '"' << json_escape(phases[i].name) << "\": " << phases[i].ms;
+		out << " },\n"
+			<< "  \"maps\": " << maps << ",\n"
+			<< "  \"maps_read\": " << mapsRead << ",\n"
+			<< "  \"bytes\": { \"maps_total\": " << mapBytesTotal << ", \"maps_read\": " << mapBytesRead
+			<< ", \"maps_hashed\": " << mapBytesHashed << ", \"mpmaps_old\": " << mpmapsOldBytes << ", \"previews\": " << previewBytesRead << " },\n"
+			<< "  \"previews_read\": " << previewsRead << ",\n"
+			<< "  \"lookups\": " << lookups << ",\n"
+			<< "  \"fallbacks\": " << fallbacks << ",\n"
+			<< "  \"notes\": " << notes << ",\n"
+			<< "  \"slowest_maps\": [";
+		for (size_t i = 0; i < slowest.size(); ++i)
+			out << (i ? "," : "") << "\n    { \"map\": \"" << json_escape(slowest[i].key) << "\", \"ms\": " << slowest[i].ms << " }";
+		out << (slowest.empty() ? "],\n" : "\n  ],\n") << "  \"duplicate_maps\": [";
+		for (size_t g = 0; g < duplicates.size(); ++g) {
+			out << (g ? "," : "") << "\n    [";
+			for (size_t i = 0; i < duplicates[g].size(); ++i)
+				out << (i ? ", " : " ") << '"' << json_escape(duplicates[g][i]) << '"';
+			out << " ]";
+		}
+		out << (duplicates.empty() ? "]\n" : "\n  ]\n") << "}\n";
+		return bool(out);
+	}
+
+private:
+	/**
+	 * Escape a string for a JSON string literal, map paths have backslashes on Windows.
+	 *
+	 * @param s string to escape.
+	 * @return escaped string, without quotes.
+	 */
+	static std::string json_escape(const std::string& s) {
+		std::string escaped;
+		for (char c : s) {
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			if ((unsigned char)c < 0x20) {
+				const char* hex = "0123456789abcdef";
+				escaped += "\\u00";
+				escaped += hex[(c >> 4) & 0xF];
+				escaped += hex[c & 0xF];
+				continue;
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+};
+
+/**
+ * Adds the time until it goes out of scope to a phase of a run, if the run is being measured.
+ */
+class PhaseTimer {
+public:
+	/**
+	 * Start timing a phase.
+	 *
+	 * @param stats stats to add the phase to, nullptr to time nothing.
+	 * @param name name of the phase.
+	 */
+	PhaseTimer(RunStats* stats, const char* name) : stats(stats), name(name) {
+		if (stats)
+			start = RunStats::Clock::now();
+	}
+
+	~PhaseTimer() {
+		if (stats)
+			stats->phases.push_back({ name, RunStats::ms_since(start) });
+	}
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+	RunStats* stats;
+	const char* name;
+	RunStats::Clock::time_point start;
+};
@@ -0,0 +1,150 @@
+/**
+ * @file sha1.h
+ * @brief SHA-1 hash, which is what the CnCNet updater identifies file versions by.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Streaming SHA-1. Data can be added in pieces of any size and gives the
+ * same result as hashing it in one go.
+ */
+class Sha1 {
+public:
+	using Digest = std::array<uint8_t, 20>;
+
+	/**
+	 * Add data to the hash.
+	 *
+	 * @param data pointer to the data.
+	 * @param len number of bytes to add.
+	 */
+	void update(const void* data, size_t len) {
+		const unsigned char* p = (const unsigned char*)data;
+		total += len;
+		if (buffered > 0) {
+			size_t fill = std::min(len, 64 - buffered);
+			std::memcpy(buffer + buffered, p, fill);
+			buffered += fill;
+			p += fill;
+			len -= fill;
+			if (buffered < 64)
+				return;
+			block(buffer);
+			buffered = 0;
+		}
+		for (; len >= 64; p += 64, len -= 64)
+			block(p);
+		std::memcpy(buffer, p, len);
+		buffered = len;
+	}
+
+	/**
+	 * Get the hash of everything added so far.
+	 *
+	 * @return 20-byte digest.
+	 */
+	Digest digest() const {
+		Sha1 last = *this; // padding would change our state, so pad a copy
+		uint64_t bits = total * 8;
+		unsigned char pad[72] = { 0x80 };
+		size_t padLen = (buffered < 56) ? 56 - buffered : 120 - buffered;
+		for (int i = 0; i < 8; ++i)
+			pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+		last.update(pad, padLen + 8);
+		Digest d;
+		for (int i = 0; i < 5; ++i)
+			for (int b = 0; b < 4; ++b)
+				d[i * 4 + b] = uint8_t(last.h[i] >> (24 - 8 * b));
+		return d;
+	}
+
+private:
+	static uint32_t rotl(uint32_t x, int r) {
+		return (x << r) | (x >> (32 - r));
+	}
+
+	void block(const unsigned char* p) {
+		uint32_t w[80];
+		for (int i = 0; i < 16; ++i)
+			w[i] = (uint32_t(p[i * 4]) << 24) | (uint32_t(p[i * 4 + 1]) << 16) | (uint32_t(p[i * 4 + 2]) << 8) | p[i * 4 + 3];
+		for (int i = 16; i < 80; ++i)
+			w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; ++i) {
+			uint32_t f, k;
+			if (i < 20) {
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40) {
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60) {
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else {
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t t = rotl(a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rotl(b, 30);
+			b = a;
+			a = t;
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+	uint64_t total = 0;
+	unsigned char buffer[64];
+	size_t buffered = 0;
+};
+
+/**
+ * Hash the whole content of a file with large sequential reads.
+ *
+ * @param path path to the file to hash.
+ * @param size set to the number of bytes hashed.
+ * @param upperCase whether to write the hex digits in upper case.
+ * @return SHA-1 of the file in hex, empty if it couldn't be read.
+ */
+inline std::string sha1_file(const std::filesystem::path& path, uint64_t& size, bool upperCase = true) {
+	size = 0;
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return std::string();
+	Sha1 hash;
+	std::vector<char> chunk(1 << 20);
+	while (in) {
+		in.read(chunk.data(), chunk.size());
+		hash.update(chunk.data(), size_t(in.gcount()));
+		size += uint64_t(in.gcount());
+	}
+	const char* digits = upperCase ? "0123456789ABCDEF" : "0123456789abcdef";
+	std::string hex;
+	for (uint8_t byte : hash.digest()) {
+		hex += digits[byte >> 4];
+		hex += digits[byte & 15];
+	}
+	return hex;
+}
@@ -0,0 +1,319 @@
+/**
+ * @file snapshot.h
+ * @brief Flat binary snapshot of everything read from a map tree.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapdata.h"
+#include "platform.h"
+#include "xxhash.h"
+
+// bump whenever the layout below changes, readers refuse any other version
+#define SNAPSHOT_VERSION 1
+
+/*
+ * Layout, all integers little endian:
+ *
+ *   SnapshotHeader
+ *   SnapshotMap[mapCount]       at mapsOffset
+ *   SnapshotStr[fileCount]      at filesOffset, every .map and .png in the tree
+ *   char[stringsSize]           at stringsOffset, every string, each stored once
+ *
+ * Strings are referenced by offset and length into the string table, so the file
+ * can be used straight from memory without any pointer fixups. The checksum is the
+ * XXH64 of everything after the header.
+ */
+
+struct SnapshotStr {
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct SnapshotHeader {
+	char magic[8]; // "YRMUSNAP"
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t checksum;
+	uint32_t mapCount;
+	uint32_t fileCount;
+	uint64_t mapsOffset;
+	uint64_t filesOffset;
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+	SnapshotStr root; // CnCNet path the snapshot was taken from, followed by a separator
+};
+
+struct SnapshotMap {
+	SnapshotStr path; // relative to CnCNet
+	SnapshotStr strings[9]; // in the order of map_data_strings
+	SnapshotStr enemyHouses[9];
+	SnapshotStr waypoints[9];
+	SnapshotStr forcedOptions; // "key=value\n" lines
+	SnapshotStr forcedSpawnIniOptions;
+	int32_t previewWidth;
+	int32_t previewHeight;
+	uint8_t enemyHouseCount;
+	uint8_t waypointCount;
+	uint8_t hasPreview;
+	uint8_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 72, "snapshot header must not have padding");
+static_assert(sizeof(SnapshotMap) == 252, "snapshot map record must not have padding");
+
+/**
+ * Write a snapshot of a map tree.
+ *
+ * @param path path to write the snapshot to.
+ * @param root CnCNet path followed by a separator, so root + map path gives the full path.
+ * @param mapPaths paths of the maps relative to CnCNet.
+ * @param maps data read from each map in 'mapPaths'.
+ * @param files every .map and .png in the tree, relative to CnCNet.
+ * @return true if the snapshot was written, false if not.
+ */
+inline bool write_snapshot(const std::filesystem::path& path, const std::string& root,
+		const std::vector<std::string>& mapPaths, const std::vector<const MapData*>& maps, const std::vector<std::string>& files) {
+	std::string strings;
+	std::unordered_map<std::string, SnapshotStr> interned; // lots of values repeat, store each once
+	auto intern = [&](const std::string& s) {
+		auto found = interned.find(s);
+		if (found != interned.end())
+			return found->second;
+		SnapshotStr ref{ uint32_t(strings.size()), uint32_t(s.size()) };
+		strings += s;
+		interned.emplace(s, ref);
+		return ref;
+	};
+	auto intern_entries = [&](const IniWriter::Entries& entries) {
+		std::string lines;
+		for (const auto& [key, value] : entries)
+			lines.append(key).append(1, '=').append(value).append(1, '\n');
+		return intern(lines);
+	};
+
+	std::vector<SnapshotMap> records(maps.size());
+	for (size_t i = 0; i < maps.size(); ++i) {
+		const MapData& m = *maps[i];
+		SnapshotMap& r = records[i];
+		std::memset(&r, 0, sizeof(r));
+		r.path = intern(mapPaths[i]);
+		auto mapStrings = map_data_strings(m);
+		for (size_t n = 0; n < mapStrings.size(); ++n)
+			r.strings[n] = intern(*mapStrings[n]);
+		r.enemyHouseCount = uint8_t(std::min<size_t>(m.enemyHouses.size(), 9));
+		for (size_t n = 0; n < r.enemyHouseCount; ++n)
+			r.enemyHouses[n] = intern(m.enemyHouses[n]);
+		r.waypointCount = uint8_t(std::min<size_t>(m.waypoints.size(), 9));
+		for (size_t n = 0; n < r.waypointCount; ++n)
+			r.waypoints[n] = intern(m.waypoints[n]);
+		r.forcedOptions = intern_entries(m.forcedOptions);
+		r.forcedSpawnIniOptions = intern_entries(m.forcedSpawnIniOptions);
+		r.hasPreview = m.hasPreview;
+		r.previewWidth = m.previewSize.first;
+		r.previewHeight = m.previewSize.second;
+	}
+	std::vector<SnapshotStr> fileRefs;
+	for (const std::string& f : files)
+		fileRefs.push_back(intern(f));
+
+	SnapshotHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "YRMUSNAP", 8);
+	header.version = SNAPSHOT_VERSION;
+	header.headerSize = sizeof(SnapshotHeader);
+	header.mapCount = uint32_t(records.size());
+	header.fileCount = uint32_t(fileRefs.size());
+	header.mapsOffset = sizeof(SnapshotHeader);
+	header.filesOffset = header.mapsOffset + records.size() * sizeof(SnapshotMap);
+	header.stringsOffset = header.filesOffset + fileRefs.size() * sizeof(SnapshotStr);
+	header.root = intern(root);
+	header.stringsSize = strings.size();
+
+	std::string body;
+	body.reserve(size_t(header.stringsOffset - sizeof(SnapshotHeader)) + strings.size());
+	body.append((const char*)records.data(), records.size() * sizeof(SnapshotMap));
+	body.append((const char*)fileRefs.data(), fileRefs.size() * sizeof(SnapshotStr));
+	body += strings;
+	Xxh64 checksum;
+	checksum.update(body.data(), body.size());
+	header.checksum = checksum.digest();
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)&header, sizeof(header));
+	out.write(body.data(), body.size());
+	return bool(out);
+}
+
+/**
+ * Read-only view of a memory-mapped snapshot. The file is validated once when
+ * it's opened, after that every access is a bounds-free lookup into the mapping.
+ */
+class SnapshotReader {
+public:
+	/**
+	 * Map and validate a snapshot.
+	 *
+	 * @param path path to the snapshot.
+	 * @param error set to the reason the snapshot was rejected.
+	 * @return true if the snapshot is usable, false if not.
+	 */
+	bool open(const std::filesystem::path& path, std::string& error) {
+		mapping = MappedFile(path);
+		if (!mapping.is_open()) {
+			error = "unable to open file";
+			return false;
+		}
+		buffer = mapping.view();
+		return validate(error);
+	}
+
+	size_t map_count() const {
+		return header().mapCount;
+	}
+
+	size_t file_count() const {
+		return header().fileCount;
+	}
+
+	/**
+	 * Get the CnCNet path the snapshot was taken from.
+	 *
+	 * @return CnCNet path followed by a separator.
+	 */
+	std::string_view root() const {
+		return str(header().root);
+	}
+
+	/**
+	 * Get the path of a map relative to CnCNet.
+	 *
+	 * @param i index of the map.
+	 * @return path of the map.
+	 */
+	std::string_view map_path(size_t i) const {
+		return str(map(i).path);
+	}
+
+	/**
+	 * Get the path of a .map or .png file relative to CnCNet.
+	 *
+	 * @param i index of the file.
+	 * @return path of the file.
+	 */
+	std::string_view file(size_t i) const {
+		return str(((const SnapshotStr*)(buffer.data() + header().filesOffset))[i]);
+	}
+
+	/**
+	 * Get the data read from a map.
+	 *
+	 * @param i index of the map.
+	 * @return data read from the map.
+	 */
+	MapData map_data(size_t i) const {
+		const SnapshotMap& r = map(i);
+		MapData m;
+		auto mapStrings = map_data_strings(m);
+		for (size_t n = 0; n < mapStrings.size(); ++n)
+			*mapStrings[n] = str(r.strings[n]);
+		for (size_t n = 0; n < r.enemyHouseCount; ++n)
+			m.enemyHouses.emplace_back(str(r.enemyHouses[n]));
+		for (size_t n = 0; n < r.waypointCount; ++n)
+			m.waypoints.emplace_back(str(r.waypoints[n]));
+		for (auto [ref, forced] : { std::pair(r.forcedOptions, &m.forcedOptions),
+				std::pair(r.forcedSpawnIniOptions, &m.forcedSpawnIniOptions) }) {
+			std::string_view lines = str(ref);
+			while (!lines.empty()) {
+				size_t eol = std::min(lines.find('\n'), lines.size());
+				std::string_view line = lines.substr(0, eol);
+				size_t eq = std::min(line.find('='), line.size());
+				forced->emplace_back(line.substr(0, eq), line.substr(std::min(eq + 1, line.size())));
+				lines.remove_prefix(std::min(eol + 1, lines.size()));
+			}
+		}
+		m.hasPreview = r.hasPreview != 0;
+		m.previewSize = { r.previewWidth, r.previewHeight };
+		return m;
+	}
+
+private:
+	const SnapshotHeader& header() const {
+		return *(const SnapshotHeader*)buffer.data();
+	}
+
+	const SnapshotMap& map(size_t i) const {
+		return ((const SnapshotMap*)(buffer.data() + header().mapsOffset))[i];
+	}
+
+	std::string_view str(const SnapshotStr& ref) const {
+		return std::string_view(buffer.data() + header().stringsOffset + ref.offset, ref.length);
+	}
+
+	/**
+	 * Check the header, the checksum, and that every string reference is inside the file.
+	 *
+	 * @param error set to the reason the snapshot was rejected.
+	 * @return true if the snapshot is usable, false if not.
+	 */
+	bool validate(std::string& error) {
+		if (buffer.size() < sizeof(SnapshotHeader) || std::memcmp(buffer.data(), "YRMUSNAP", 8) != 0) {
+			error = "not a snapshot";
+			return false;
+		}
+		const SnapshotHeader& h = header();
+		if (h.version != SNAPSHOT_VERSION || h.headerSize != sizeof(SnapshotHeader)) {
+			error = "snapshot is from a different version";
+			return false;
+		}
+		uint64_t size = buffer.size();
+		if (h.mapsOffset != sizeof(SnapshotHeader)
+				|| h.filesOffset != h.mapsOffset + uint64_t(h.mapCount) * sizeof(SnapshotMap)
+				|| h.stringsOffset != h.filesOffset + uint64_t(h.fileCount) * sizeof(SnapshotStr)
+				|| h.stringsOffset + h.stringsSize != size) {
+			error = "snapshot is truncated";
+			return false;
+		}
+		Xxh64 checksum;
+		checksum.update(buffer.data() + sizeof(SnapshotHeader), size_t(size - sizeof(SnapshotHeader)));
+		if (checksum.digest() != h.checksum) {
+			error = "snapshot checksum doesn't match";
+			return false;
+		}
+		auto inside = [&](const SnapshotStr& ref) {
+			return uint64_t(ref.offset) + ref.length <= h.stringsSize;
+		};
+		bool ok = inside(h.root);
+		for (size_t i = 0; ok && i < h.fileCount; ++i)
+			ok = inside(((const SnapshotStr*)(buffer.data() + h.filesOffset))[i]);
+		for (size_t i = 0; ok && i < h.mapCount; ++i) {
+			const SnapshotMap& r = map(i);
+			ok = r.enemyHouseCount <= 9 && r.waypointCount <= 9 && inside(r.path)
+				&& inside(r.forcedOptions) && inside(r.forcedSpawnIniOptions);
+			for (const SnapshotStr& ref : r.strings)
+				ok = ok && inside(ref);
+			for (size_t n = 0; n < r.enemyHouseCount; ++n)
+				ok = ok && inside(r.enemyHouses[n]);
+			for (size_t n = 0; n < r.waypointCount; ++n)
+				ok = ok && inside(r.waypoints[n]);
+		}
+		if (!ok) {
+			error = "snapshot has a string outside of its string table";
+			return false;
+		}
+		return true;
+	}
+
+	MappedFile mapping;
+	std::string_view buffer; // the whole file
+};
@@ -0,0 +1,90 @@
+/**
+ * @file strutil.h
+ * @brief Small string helpers shared by the tool and the benchmarks.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cctype>
+#include <string>
+
+#define NULLSTR ""
+
+/**
+ * Check if a string begins with a substring.
+ *
+ * @param s string to check.
+ * @param start substring to check beginning for.
+ * @return true if 's' begins with 'start', false if not.
+ */
+inline bool str_startswith(const std::string& s, const std::string& start) {
+	return (s.length() >= start.length()) ? (s.compare(0, start.length(), start) == 0) : false;
+}
+
+/**
+ * Check if a string ends with a substring.
+ *
+ * @param s string to check.
+ * @param end substring to check ending for.
+ * @return true if 's' ends with 'end', false if not.
+ */
+inline bool str_endswith(const std::string& s, const std::string& end) {
+	return (s.length() >= end.length()) ?
+		(s.compare(s.length() - end.length(), end.length(), end) == 0) : false;
+}
+
+/**
+ * Remove specified number of characters from
+ * the beginning and end of a string.
+ *
+ * @param s string to modify.
+ * @param left number of characters to remove from the beginning of 's'.
+ * @param right number of characters to remove from the end of 's'.
+ * @return modified copy of 's'.
+ */
+inline std::string str_cutends(const std::string& s, const int& left, const int& right) {
+	int len = s.size() - left - right;
+	if (len <= 0)
+		return NULLSTR;
+	return s.substr(left, len);
+}
+
+/**
+ * Capitalizes the first letter of each word in a string in place,
+ * e.g. "hello, world!" becomes "Hello, World!".
+ *
+ * @param s string to capitalize.
+ * @param n length of 's'.
+ */
+inline void str_titlecase(char* s, size_t n) {
+	bool capNextLetter = true;
+	for (size_t i = 0; i < n; ++i) {
+		if (capNextLetter) {
+			if (std::isalpha(s[i])) {
+				s[i] = std::toupper(s[i]);
+				capNextLetter = false;
+			}
+		}
+		else {
+			if (std::isalpha(s[i])) {
+				s[i] = std::tolower(s[i]);
+			}
+			else {
+				capNextLetter = true;
+			}
+		}
+	}
+}
+
+/**
+ * Capitalizes the first letter of each word in a string,
+ * e.g. "hello, world!" becomes "Hello, World!".
+ *
+ * @param s string to capitalize.
+ * @return capitalized copy of 's'.
+ */
+inline std::string str_titlecase(std::string s) {
+	str_titlecase(s.data(), s.size());
+	return s;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file threadpool.h
+ * @brief Fixed-size thread pool which runs loops with work stealing.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of worker threads for running the iterations of a loop in parallel.
+ *
+ * Each worker gets its own queue of iterations and takes from the front of it,
+ * and a worker whose queue runs dry steals from the back of the others, so a
+ * few slow iterations (huge maps) don't leave the rest of the pool idle.
+ * A pool of one thread runs everything on the calling thread, in order.
+ */
+class ThreadPool {
+public:
+	/**
+	 * Start the worker threads.
+	 *
+	 * @param threads number of threads to run loops on, 0 for one per core.
+	 */
+	explicit ThreadPool(size_t threads = 0) {
+		if (threads == 0)
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		queues = std::vector<Queue>(threads);
+		if (threads > 1)
+			for (size_t w = 0; w < threads; ++w)
+				workers.emplace_back([this, w] { work(w); });
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> l(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& t : workers)
+			t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Get the number of threads loops are run on.
+	 *
+	 * @return number of threads.
+	 */
+	size_t size() const {
+		return queues.size();
+	}
+
+	/**
+	 * Call a function for every index in [0, count) and wait for all of them
+	 * to finish. The first exception thrown by any call is rethrown here.
+	 *
+	 * @param count number of iterations.
+	 * @param fn function taking the iteration index and the index of the
+	 *           worker running it, for keeping per-thread results.
+	 */
+	template <class Fn>
+	void parallel_for(size_t count, Fn&& fn) {
+		if (workers.empty()) {
+			for (size_t i = 0; i < count; ++i)
+				fn(i, size_t(0));
+			return;
+		}
+
+		std::lock_guard<std::mutex> batchLock(batch); // one loop at a time
+		for (size_t i = 0; i < count; ++i)
+			queues[i % queues.size()].items.push_back(i);
+		std::unique_lock<std::mutex> l(lock);
+		job = [&fn](size_t i, size_t w) { fn(i, w); };
+		error = nullptr;
+		running = workers.size();
+		++generation;
+		wake.notify_all();
+		done.wait(l, [this] { return running == 0; });
+		job = nullptr;
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+private:
+	struct Queue {
+		std::mutex lock;
+		std::deque<size_t> items;
+	};
+
+	/**
+	 * Main loop of each worker thread.
+	 *
+	 * @param self index of this worker.
+	 */
+	void work(size_t self) {
+		size_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> l(lock);
+				wake.wait(l, [&] { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+			size_t i;
+			while (take(self, i)) {
+				try {
+					job(i, self);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> l(lock);
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+			std::lock_guard<std::mutex> l(lock);
+			if (--running == 0)
+				done.notify_one();
+		}
+	}
+
+	/**
+	 * Take the next iteration from our own queue, or steal one from another worker.
+	 *
+	 * @param self index of this worker.
+	 * @param i set to the taken iteration index.
+	 * @return true if an iteration was taken, false if every queue is empty.
+	 */
+	bool take(size_t self, size_t& i) {
+		for (size_t k = 0; k < queues.size(); ++k) {
+			Queue& q = queues[(self + k) % queues.size()];
+			std::lock_guard<std::mutex> l(q.lock);
+			if (q.items.empty())
+				continue;
+			if (k == 0) {
+				i = q.items.front();
+				q.items.pop_front();
+			}
+			else {
+				i = q.items.back();
+				q.items.pop_back();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<Queue> queues;
+	std::vector<std::thread> workers;
+	std::mutex batch;
+	std::mutex lock; // guards everything below
+	std::condition_variable wake, done;
+	std::function<void(size_t, size_t)> job;
+	std::exception_ptr error;
+	size_t running = 0;
+	size_t generation = 0;
+	bool stopping = false;
+};
+
+/**
+ * Sort a range on a pool: pieces of it are sorted at the same time, then
+ * merged a pair at a time. Small ranges aren't worth splitting and are
+ * sorted on the calling thread. The order is the same as std::sort's
+ * for any comparison without ties.
+ *
+ * @param pool threads to sort on.
+ * @param first start of the range.
+ * @param last end of the range.
+ * @param comp comparison to sort by.
+ * @param minPerThread fewest elements worth giving a thread of their own.
+ */
+template <class It, class Compare>
+void parallel_sort(ThreadPool& pool, It first, It last, Compare comp, size_t minPerThread = 4096) {
+	size_t n = size_t(last - first);
+	size_t pieces = std::min(pool.size(), n / minPerThread);
+	if (pieces < 2) {
+		std::sort(first, last, comp);
+		return;
+	}
+	std::vector<size_t> bounds(pieces + 1);
+	for (size_t p = 0; p <= pieces; ++p)
+		bounds[p] = n * p / pieces;
+	pool.parallel_for(pieces, [&](size_t p, size_t) {
+		std::sort(first + bounds[p], first + bounds[p + 1], comp);
+	});
+	for (size_t width = 1; width < pieces; width *= 2) {
+		pool.parallel_for((pieces + 2 * width - 1) / (2 * width), [&](size_t pair, size_t) {
+			size_t lo = pair * 2 * width;
+			size_t mid = std::min(lo + width, pieces);
+			size_t hi = std::min(lo + 2 * width, pieces);
+			if (mid < hi)
+				std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], comp);
+		});
+	}
+}
@@ -0,0 +1,185 @@
+/**
+ * @file versionconfig.h
+ * @brief Reading versionconfig.ini entries and working out which of them need updating.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "inidocument.h"
+
+/**
+ * A file as the CnCNet updater sees it, "path=hash,size" in versionconfig.ini.
+ */
+struct VersionEntry {
+	std::string path; // relative to CnCNet
+	std::string hash; // SHA-1 of the file in hex
+	uint64_t size = 0; // in KB, rounded up
+};
+
+/**
+ * Convert a file size to the unit versionconfig.ini uses.
+ *
+ * @param bytes size of the file in bytes.
+ * @return size in KB, rounded up.
+ */
+inline uint64_t versionconfig_size(uint64_t bytes) {
+	return (bytes + 1023) / 1024;
+}
+
+/**
+ * Get the key a path is looked up by. The updater runs on Windows, where
+ * paths are case-insensitive and either separator works.
+ *
+ * @param path path relative to CnCNet.
+ * @return lowercase path with backslashes.
+ */
+inline std::string version_key(std::string_view path) {
+	std::string key(path);
+	for (char& c : key)
+		c = (c == '/') ? '\\' : char(std::tolower((unsigned char)c));
+	return key;
+}
+
+/**
+ * Split a versionconfig.ini line into its path, hash and size.
+ *
+ * @param line line to parse.
+ * @param entry set to the parsed entry.
+ * @return true if the line is an entry, false if not.
+ */
+inline bool parse_version_entry(std::string_view line, VersionEntry& entry) {
+	size_t eq = line.find('=');
+	if (eq == std::string_view::npos)
+		return false;
+	std::string_view value = str_trim(line.substr(eq + 1));
+	size_t comma = value.find(',');
+	entry.path = std::string(str_trim(line.substr(0, eq)));
+	entry.hash = std::string(str_trim(value.substr(0, comma)));
+	entry.size = 0;
+	if (comma != std::string_view::npos)
+		entry.size = std::strtoull(std::string(str_trim(value.substr(comma + 1))).c_str(), nullptr, 10);
+	return !entry.path.empty();
+}
+
+/**
+ * Read the entries for every file under a directory from versionconfig.ini.
+ *
+ * @param path path to versionconfig.ini.
+ * @param prefix directory to read entries for, relative to CnCNet.
+ * @return entries in the order they appear in the file.
+ */
+inline std::vector<VersionEntry> read_versionconfig(const std::filesystem::path& path, const std::string& prefix) {
+	std::vector<VersionEntry> entries;
+	std::ifstream config(path);
+	std::string line, prefixKey = version_key(prefix);
+	VersionEntry entry;
+	while (std::getline(config, line))
+		if (parse_version_entry(line, entry) && version_key(entry.path).compare(0, prefixKey.length(), prefixKey) == 0)
+			entries.push_back(entry);
+	return entries;
+}
+
+/**
+ * Work out whether versionconfig.ini writes its hashes in upper or lower case,
+ * so the lines we generate match the ones already there.
+ *
+ * @param entries entries read from versionconfig.ini.
+ * @return true for upper case, which is also used if there's nothing to go by.
+ */
+inline bool versionconfig_upper_case(const std::vector<VersionEntry>& entries) {
+	for (const VersionEntry& e : entries)
+		for (char c : e.hash) {
+			if (c >= 'a' && c <= 'f')
+				return false;
+			if (c >= 'A' && c <= 'F')
+				return true;
+		}
+	return true;
+}
+
+/**
+ * Files which differ between a tree and versionconfig.ini.
+ */
+struct VersionDiff {
+	std::vector<VersionEntry> missing;  // in the tree but not in versionconfig.ini
+	std::vector<VersionEntry> stale;    // in both, but the hash or size differs
+	std::vector<VersionEntry> orphaned; // in versionconfig.ini but not in the tree
+	size_t current = 0;
+};
+
+/**
+ * Compare the files in a tree against versionconfig.ini, in one pass over each.
+ *
+ * Stale entries are written with the path as versionconfig.ini spells it, so they
+ * replace the existing lines as they are. Files without a hash are only checked
+ * by size, and not checked at all if sizes aren't known either.
+ *
+ * @param config entries read from versionconfig.ini.
+ * @param tree entries for the files in the tree, as they should be written.
+ * @param sizesKnown whether the sizes of the tree entries can be compared.
+ * @return every file whose entry is missing, stale or orphaned.
+ */
+inline VersionDiff diff_versionconfig(const std::vector<VersionEntry>& config, const std::vector<VersionEntry>& tree, bool sizesKnown = true) {
+	std::unordered_map<std::string, const VersionEntry*> configIndex;
+	configIndex.reserve(config.size());
+	for (const VersionEntry& e : config)
+		configIndex.emplace(version_key(e.path), &e); // first entry for a path wins, like the updater
+	std::unordered_set<std::string> inTree;
+	inTree.reserve(tree.size());
+	VersionDiff diff;
+	for (const VersionEntry& e : tree) {
+		std::string key = version_key(e.path);
+		auto found = configIndex.find(key);
+		inTree.insert(std::move(key));
+		if (found == configIndex.end()) {
+			diff.missing.push_back(e);
+			continue;
+		}
+		const VersionEntry& old = *found->second;
+		if ((!e.hash.empty() && !str_iequals(old.hash, e.hash)) || (sizesKnown && old.size != e.size)) {
+			diff.stale.push_back(e);
+			diff.stale.back().path = old.path;
+		}
+		else {
+			++diff.current;
+		}
+	}
+	for (const VersionEntry& e : config)
+		if (inTree.find(version_key(e.path)) == inTree.end())
+			diff.orphaned.push_back(e);
+	return diff;
+}
+
+/**
+ * Write the differences as lines which can be pasted into versionconfig.ini.
+ *
+ * @param out stream to write to.
+ * @param diff differences to write.
+ */
+inline void write_versionconfig_diff(std::ostream& out, const VersionDiff& diff) {
+	auto write_entries = [&out](const char* heading, const std::vector<VersionEntry>& entries, bool withHash) {
+		out << "; " << heading << " (" << entries.size() << ")" << std::endl;
+		for (const VersionEntry& e : entries) {
+			out << e.path;
+			if (withHash)
+				out << '=' << e.hash << ',' << e.size;
+			out << std::endl;
+		}
+		out << std::endl;
+	};
+	write_entries("missing, add these", diff.missing, true);
+	write_entries("stale, replace the existing entries with these", diff.stale, true);
+	write_entries("orphaned, delete these entries", diff.orphaned, false);
+}
@@ -0,0 +1,269 @@
+/**
+ * @file watcher.h
+ * @brief Waiting for changes to the map tree and the INI files MPMaps.ini is built from.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Waits for files to change, with inotify on Linux and by polling their
+ * sizes and modification times everywhere else.
+ *
+ * Changes come in bursts (a map and its preview, a whole folder copied in),
+ * so wait() only returns once nothing has changed for a short while.
+ */
+class TreeWatcher {
+public:
+	using Clock = std::chrono::steady_clock;
+	using Millis = std::chrono::milliseconds;
+
+	/**
+	 * Start a watcher with nothing to watch.
+	 *
+	 * @param quiet how long nothing has to change for before a burst of changes is over.
+	 * @param poll how often to look for changes when they have to be polled.
+	 */
+	explicit TreeWatcher(Millis quiet = Millis(100), Millis poll = Millis(250)) : quiet(quiet), pollInterval(poll) {
+#ifdef __linux__
+		fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+#endif
+	}
+
+	~TreeWatcher() {
+#ifdef __linux__
+		if (fd >= 0)
+			::close(fd);
+#endif
+	}
+
+	TreeWatcher(const TreeWatcher&) = delete;
+	TreeWatcher& operator=(const TreeWatcher&) = delete;
+
+	/**
+	 * Check whether changes are being polled for instead of reported by the OS.
+	 *
+	 * @return true if polling, false if not.
+	 */
+	bool polling() const {
+		return fd < 0;
+	}
+
+	/**
+	 * Watch a directory and everything in it, including directories added later.
+	 *
+	 * @param dir directory to watch.
+	 */
+	void watch_tree(const std::filesystem::path& dir) {
+		trees.push_back(dir);
+#ifdef __linux__
+		if (!polling())
+			add_tree(dir);
+#endif
+		last = signature();
+	}
+
+	/**
+	 * Watch a single file. Its directory is watched, so editors which save by
+	 * replacing the file don't lose the watch.
+	 *
+	 * @param file file to watch.
+	 */
+	void watch_file(const std::filesystem::path& file) {
+		files.push_back(file);
+#ifdef __linux__
+		if (!polling())
+			add_dir(file.parent_path(), file.filename().string(), false);
+#endif
+		last = signature();
+	}
+
+	/**
+	 * Wait for something being watched to change, then for the changes to settle.
+	 */
+	void wait() {
+		if (polling()) {
+			while (signature() == last)
+				std::this_thread::sleep_for(pollInterval);
+			// keep looking until it stops changing, or until changes have gone on too long to keep waiting
+			auto giveUp = Clock::now() + quiet * 4;
+			for (uint64_t sig = signature(); Clock::now() < giveUp; ) {
+				std::this_thread::sleep_for(quiet);
+				uint64_t next = signature();
+				if (next == sig)
+					break;
+				sig = next;
+			}
+			last = signature();
+			return;
+		}
+#ifdef __linux__
+		while (!read_events(-1)) {}
+		auto giveUp = Clock::now() + quiet * 4;
+		auto settled = Clock::now() + quiet;
+		for (;;) {
+			auto until = std::min(settled, giveUp);
+			auto now = Clock::now();
+			if (now >= until)
+				break;
+			if (read_events(int(std::chrono::duration_cast<Millis>(until - now).count()) + 1))
+				settled = Clock::now() + quiet;
+		}
+#endif
+	}
+
+private:
+	struct Watch {
+		std::filesystem::path dir;
+		bool recursive = false;
+		std::vector<std::string> names; // files to report changes to, every file if empty
+	};
+
+	/**
+	 * Sum up the sizes and modification times of everything watched, for polling.
+	 *
+	 * @return hash of everything watched.
+	 */
+	uint64_t signature() const {
+		if (!polling())
+			return 0;
+		uint64_t sig = 0;
+		auto mix = [&](const std::filesystem::path& path, const std::filesystem::directory_entry& e) {
+			std::error_code ec;
+			uint64_t h = std::hash<std::string>()(path.string());
+			h ^= e.file_size(ec) * 0x9E3779B97F4A7C15ull;
+			h ^= uint64_t(e.last_write_time(ec).time_since_epoch().count()) * 0xC2B2AE3D27D4EB4Full;
+			sig += h; // order doesn't matter, the walk's order isn't fixed
+		};
+		std::error_code ec;
+		for (const std::filesystem::path& dir : trees) {
+			for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+					it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+				if (ec)
+					break;
+				mix(it->path(), *it);
+			}
+		}
+		for (const std::filesystem::path& file : files)
+			mix(file, std::filesystem::directory_entry(file, ec));
+		return sig;
+	}
+
+#ifdef __linux__
+	static constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+		| IN_DELETE_SELF | IN_MOVE_SELF;
+
+	/**
+	 * Add a directory to inotify.
+	 *
+	 * @param dir directory to watch.
+	 * @param name file in it to report changes to, empty for every file.
+	 * @param recursive whether directories added to it are watched too.
+	 */
+	void add_dir(const std::filesystem::path& dir, const std::string& name, bool recursive) {
+		int wd = inotify_add_watch(fd, dir.c_str(), watchMask);
+		if (wd < 0)
+			return;
+		// the same directory always gets the same watch, so merge what's wanted from it
+		auto [it, added] = watches.try_emplace(wd);
+		Watch& w = it->second;
+		if (added) {
+			w.dir = dir;
+			w.recursive = recursive;
+			if (!name.empty())
+				w.names.push_back(name);
+		}
+		else if (name.empty() || w.names.empty()) {
+			w.names.clear();
+			w.recursive |= recursive;
+		}
+		else {
+			w.names.push_back(name);
+		}
+	}
+
+	/**
+	 * Add a directory and every directory under it to inotify.
+	 *
+	 * @param dir directory to watch.
+	 */
+	void add_tree(const std::filesystem::path& dir) {
+		add_dir(dir, "", true);
+		std::error_code ec;
+		for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+				it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (ec)
+				break;
+			if (it->is_directory(ec))
+				add_dir(it->path(), "", true);
+		}
+	}
+
+	/**
+	 * Read whatever events have come in, waiting for them if there are none.
+	 *
+	 * @param timeout milliseconds to wait for events, -1 to wait forever.
+	 * @return true if anything being watched changed, false if not.
+	 */
+	bool read_events(int timeout) {
+		pollfd p = { fd, POLLIN, 0 };
+		if (::poll(&p, 1, timeout) <= 0)
+			return false;
+		bool changed = false;
+		alignas(inotify_event) char buf[16384];
+		for (;;) {
+			ssize_t n = ::read(fd, buf, sizeof(buf));
+			if (n <= 0)
+				break;
+			for (char* at = buf; at < buf + n; ) {
+				const inotify_event* ev = (const inotify_event*)at;
+				at += sizeof(inotify_event) + ev->len;
+				if (ev->mask & IN_Q_OVERFLOW) { // events were lost, assume anything could have changed
+					changed = true;
+					continue;
+				}
+				auto found = watches.find(ev->wd);
+				if (found == watches.end())
+					continue;
+				if (ev->mask & IN_IGNORED) { // the directory is gone
+					watches.erase(found);
+					continue;
+				}
+				const Watch& w = found->second;
+				std::string name = (ev->len > 0) ? std::string(ev->name) : std::string();
+				if (!w.names.empty() && std::find(w.names.begin(), w.names.end(), name) == w.names.end())
+					continue;
+				changed = true;
+				if (w.recursive && (ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+					add_tree(w.dir / name); // a new directory, watch it and whatever was already put in it
+			}
+		}
+		return changed;
+	}
+
+	std::unordered_map<int, Watch> watches; // by inotify watch descriptor
+#endif
+
+	int fd = -1; // inotify instance, -1 when polling
+	Millis quiet;
+	Millis pollInterval;
+	std::vector<std::filesystem::path> trees;
+	std::vector<std::filesystem::path> files;
+	uint64_t last = 0; // signature when last checked, when polling
+};
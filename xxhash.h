@@ -0,0 +1,147 @@
+/**
+ * @file xxhash.h
+ * @brief XXH64 hash, used to tell whether a file's content has changed.
+ * @author Chrono Vortex#9916@Discord
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+/**
+ * Streaming XXH64, a fast non-cryptographic 64-bit hash
+ * (https://github.com/Cyan4973/xxHash). Data can be added in
+ * pieces of any size and gives the same result as hashing it in one go.
+ */
+class Xxh64 {
+public:
+	explicit Xxh64(uint64_t seed = 0) :
+		v{ seed + P1 + P2, seed + P2, seed, seed - P1 }, seed(seed) {}
+
+	/**
+	 * Add data to the hash.
+	 *
+	 * @param data pointer to the data.
+	 * @param len number of bytes to add.
+	 */
+	void update(const void* data, size_t len) {
+		const unsigned char* p = (const unsigned char*)data;
+		total += len;
+		if (buffered + len < 32) {
+			std::memcpy(buffer + buffered, p, len);
+			buffered += len;
+			return;
+		}
+		if (buffered > 0) {
+			size_t fill = 32 - buffered;
+			std::memcpy(buffer + buffered, p, fill);
+			stripe(buffer);
+			p += fill;
+			len -= fill;
+			buffered = 0;
+		}
+		for (; len >= 32; p += 32, len -= 32)
+			stripe(p);
+		std::memcpy(buffer, p, len);
+		buffered = len;
+	}
+
+	/**
+	 * Get the hash of everything added so far.
+	 *
+	 * @return 64-bit hash.
+	 */
+	uint64_t digest() const {
+		uint64_t h;
+		if (total >= 32) {
+			h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+			for (uint64_t lane : v)
+				h = (h ^ round(0, lane)) * P1 + P4;
+		}
+		else {
+			h = seed + P5;
+		}
+		h += total;
+
+		const unsigned char* p = buffer;
+		size_t len = buffered;
+		for (; len >= 8; p += 8, len -= 8)
+			h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+		if (len >= 4) {
+			h = rotl(h ^ (uint64_t(read32(p)) * P1), 23) * P2 + P3;
+			p += 4;
+			len -= 4;
+		}
+		for (; len > 0; ++p, --len)
+			h = rotl(h ^ (uint64_t(*p) * P5), 11) * P1;
+
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P3;
+		h ^= h >> 32;
+		return h;
+	}
+
+private:
+	static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+	static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+	static constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+	static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+	static constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+	static uint64_t rotl(uint64_t x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	static uint64_t round(uint64_t acc, uint64_t input) {
+		return rotl(acc + input * P2, 31) * P1;
+	}
+
+	// little endian reads, which is what every platform we build on is
+	static uint64_t read64(const unsigned char* p) {
+		uint64_t x;
+		std::memcpy(&x, p, 8);
+		return x;
+	}
+
+	static uint32_t read32(const unsigned char* p) {
+		uint32_t x;
+		std::memcpy(&x, p, 4);
+		return x;
+	}
+
+	void stripe(const unsigned char* p) {
+		for (int i = 0; i < 4; ++i)
+			v[i] = round(v[i], read64(p + i * 8));
+	}
+
+	uint64_t v[4];
+	uint64_t seed;
+	uint64_t total = 0;
+	unsigned char buffer[32];
+	size_t buffered = 0;
+};
+
+/**
+ * Hash the whole content of a file with large sequential reads.
+ *
+ * @param path path to the file to hash.
+ * @return XXH64 of the file, 0 if it couldn't be read.
+ */
+inline uint64_t xxh64_file(const std::filesystem::path& path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		return 0;
+	Xxh64 hash;
+	std::vector<char> chunk(1 << 20);
+	while (in) {
+		in.read(chunk.data(), chunk.size());
+		hash.update(chunk.data(), size_t(in.gcount()));
+	}
+	return hash.digest();
+}